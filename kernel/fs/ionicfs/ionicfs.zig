@@ -13,6 +13,28 @@ pub const EMPTY_REGION = 0x0;
 pub const DELETED_REGION = 0x1;
 pub const DIRECTORY_REGION = 0x2;
 pub const FILE_REGION = 0x3;
+pub const EXTENT_REGION = 0x7;
+
+// Version in the sanity check at the end of the preface, 5 for IONFS005, or
+// 0 when it is not a number.
+pub fn formatVersion(drive: *ata.AtaDrive) u32 {
+    const sector_data = ata.readSectors(drive, 0, 1);
+    var version: u32 = 0;
+    for (sector_data[509..512]) |digit| {
+        if (digit < '0' or digit > '9') return 0;
+        version = version * 10 + (digit - '0');
+    }
+    return version;
+}
+
+// Writes only know the entry layout of the formats before 005.
+fn formatWritable(drive: *ata.AtaDrive) bool {
+    if (formatVersion(drive) >= 5) {
+        out.println("Disk format is too new to be written.");
+        return false;
+    }
+    return true;
+}
 
 pub fn detectPartitions(drive: *ata.AtaDrive) [4]vfs.Partition {
     const sector_data = ata.readSectors(drive, 0, 1);
@@ -71,6 +93,11 @@ pub fn parseDirectory(drive: *ata.AtaDrive, region: u32, dirName: []const u8) vf
     var entries = mem.Array(vfs.DirectoryEntry).init();
     var current_region: u32 = region;
 
+    // From format 005 on, the u64 size of a file follows the region of its
+    // entry.
+    const version = formatVersion(drive);
+    const trailerSize: usize = if (version >= 5) 12 else 4;
+
     while (current_region != 0) {
         const sector_data = ata.readSectors(drive, current_region, 1);
 
@@ -92,7 +119,17 @@ pub fn parseDirectory(drive: *ata.AtaDrive, region: u32, dirName: []const u8) vf
             }
 
             if (entryType == DELETED_REGION) {
-                offset += 1;
+                // From format 005 on deleted entries keep their layout. The
+                // index marker of a directory is one with an empty name.
+                if (version >= 5 or sector_data[offset + 25] == 0) {
+                    offset += 25;
+                    while (offset < 508 and sector_data[offset] != 0) {
+                        offset += 1;
+                    }
+                    offset += 1 + trailerSize;
+                } else {
+                    offset += 1;
+                }
                 continue;
             }
 
@@ -139,7 +176,7 @@ pub fn parseDirectory(drive: *ata.AtaDrive, region: u32, dirName: []const u8) vf
 
             offset += 1; // Skip the null terminator
 
-            if (offset + 4 > 508) {
+            if (offset + trailerSize > 508) {
                 out.println("Directory entry region number overflow.");
                 break;
             }
@@ -148,7 +185,7 @@ pub fn parseDirectory(drive: *ata.AtaDrive, region: u32, dirName: []const u8) vf
             for (0..4) |j| {
                 entry_region |= @as(u32, sector_data[offset + j]) << @as(u5, @intCast(j * 8));
             }
-            offset += 4;
+            offset += trailerSize;
 
             const buf = alloc.duplicate(u8, name.snapshot());
             if (buf == null) {
@@ -276,6 +313,10 @@ pub fn readFile(drive: *ata.AtaDrive, filePath: []const u8, partition: u32) ?[]c
     var buffer = mem.Buffer(u8, 507).init();
     while (true) {
         const byte = sector.get(1).?[0];
+        if (byte == EXTENT_REGION) {
+            out.println("Extent files are not supported.");
+            return null;
+        }
         if (byte == FILE_REGION) {
             const fileData = sector.get(507).?;
             buffer.push(fileData);
@@ -316,13 +357,33 @@ pub fn readFile(drive: *ata.AtaDrive, filePath: []const u8, partition: u32) ?[]c
     return data[start..end];
 }
 
+// From format 003 on, the regions after the root directory of a partition
+// hold a bit per region, set while it is in use. Extent data has no type
+// byte, so only its bit tells it is taken.
+fn bitmapMarksUsed(drive: *ata.AtaDrive, partition: u32, region: u32) bool {
+    const start = @as(u32, @intCast(drive.partitions[partition].start_sector));
+    const bitsPerRegion: u32 = 507 * 8;
+    const index = region - start;
+    var bitmapRegion: u32 = start + 1;
+    var skipped: u32 = 0;
+    while (skipped < index / bitsPerRegion) : (skipped += 1) {
+        const linkData = ata.readSectors(drive, bitmapRegion, 1);
+        const next = mem.reinterpretBytes(u32, linkData[508..512], false).unwrap();
+        bitmapRegion = if (next != 0) next else bitmapRegion + 1;
+    }
+    const bitmapData = ata.readSectors(drive, bitmapRegion, 1);
+    const bit = index % bitsPerRegion;
+    return ((bitmapData[1 + bit / 8] >> @as(u3, @intCast(bit % 8))) & 1) != 0;
+}
+
 pub fn findFreeRegion(drive: *ata.AtaDrive, partition: u32, ignore: []u32) u32 {
     @setRuntimeSafety(false);
+    const hasBitmap = formatVersion(drive) >= 3;
     var currentRegion: u32 = @as(u32, @intCast(drive.partitions[partition].start_sector));
     while (currentRegion >= drive.partitions[partition].start_sector and currentRegion < drive.partitions[partition].start_sector + drive.partitions[partition].size) {
         const sector_data = ata.readSectors(drive, currentRegion, 1);
         if (sector_data[0] == EMPTY_REGION or sector_data[0] == DELETED_REGION) {
-            var isFree = true;
+            var isFree = !hasBitmap or !bitmapMarksUsed(drive, partition, currentRegion);
             for (ignore) |ignoredRegion| {
                 if (ignoredRegion == currentRegion) {
                     isFree = false;
@@ -428,6 +489,9 @@ pub fn createDirectory(drive: *ata.AtaDrive, dirName: []const u8, partition: u32
         out.println("Partition does not exist.");
         return;
     }
+    if (!formatWritable(drive)) {
+        return;
+    }
 
     var withoutLastComponent: []const u8 = "";
     var directoryName: []const u8 = "";
@@ -539,6 +603,9 @@ pub fn createFile(drive: *ata.AtaDrive, fileName: []const u8, partition: u32) vo
         out.println("Partition does not exist.");
         return;
     }
+    if (!formatWritable(drive)) {
+        return;
+    }
 
     var withoutLastComponent: []const u8 = "";
     var fileNameOnly: []const u8 = "";
@@ -633,6 +700,9 @@ pub fn writeToFile(drive: *ata.AtaDrive, fileName: []const u8, contents: []const
         out.println("Partition does not exist.");
         return;
     }
+    if (!formatWritable(drive)) {
+        return;
+    }
 
     var withoutLastComponent: []const u8 = "";
     var fileNameOnly: []const u8 = "";
@@ -902,6 +972,9 @@ pub fn deleteFile(drive: *ata.AtaDrive, fileName: []const u8, partition: u32) vo
         out.println("Partition does not exist.");
         return;
     }
+    if (!formatWritable(drive)) {
+        return;
+    }
 
     var withoutLastComponent: []const u8 = "";
     var fileNameOnly: []const u8 = "";
@@ -0,0 +1,24 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+
+// Monotonic storage for the entry names of a directory listing. Names are
+// never freed one by one: the whole arena is dropped with release(), or
+// with the listing that owns it.
+class DirectoryArena {
+  public:
+    DirectoryArena();
+    DirectoryArena(const DirectoryArena &) = delete;
+    DirectoryArena &operator=(const DirectoryArena &) = delete;
+
+    std::string_view intern(const char *data, std::size_t length);
+    void release();
+
+  private:
+    std::pmr::monotonic_buffer_resource pool;
+};
+
+#endif // ARENA_HPP
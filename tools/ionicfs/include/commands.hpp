@@ -1,6 +1,7 @@
 #ifndef COMMANDS_HPP
 #define COMMANDS_HPP
 
+#include "ionicfs.hpp"
 #include <filesystem>
 #include <optional>
 #include <string>
@@ -8,8 +9,6 @@
 
 namespace fs = std::filesystem;
 
-#define IONICFS_VERSION "002"
-
 #define BOLD "\033[1m"
 #define GREEN "\033[32m"
 #define RED "\033[31m"
@@ -17,67 +16,68 @@ namespace fs = std::filesystem;
 #define RESET "\033[0m"
 #define CYAN "\033[36m"
 
-#define EMPTY_REGION 0x0
-#define DELETED_REGION 0x1
-#define DIRECTORY_REGION 0x2
-#define FILE_REGION 0x3
-
-struct Partition {
-    char name[18];
-    std::uint32_t partitionRegion;
-    std::uint32_t partitionSize; // in regions
-    bool usable = true;
-} __attribute__((packed));
-
-struct DriveInformation {
-    Partition partitions[4];
-    char bootCode[400];
-    std::uintmax_t diskSize;
-    std::uintmax_t totalRegions;
-    char version[9];
-};
-
-struct DirectoryEntry {
-    std::string name;
-    uint64_t lastAccessed;
-    uint64_t lastModified;
-    uint64_t created;
-    uint32_t region;
-    bool isDirectory;
-};
-
-struct Directory {
-    uint32_t region;
-    std::vector<DirectoryEntry> entries;
-};
-
-void formatDisk(const fs::path &diskPath);
-std::optional<DriveInformation> getDriveInformation(const fs::path &diskPath);
-void info(const fs::path &diskPath);
-Directory parseRootDirectory(const fs::path &diskPath, int partitionIndex);
-Directory parseDirectory(const fs::path &diskPath, uint32_t region);
-uint32_t traverseDirectory(const fs::path &diskPath,
-                           const std::string &directoryName,
-                           int partitionIndex);
-void createDirectory(const fs::path &diskPath, const std::string &dirName,
+// Every command reports its own errors and returns whether it succeeded.
+bool formatDisk(const fs::path &diskPath, uint32_t regionSize);
+bool info(const fs::path &diskPath);
+bool listDirectory(const fs::path &diskPath, int partitionIndex);
+bool statPath(const fs::path &diskPath, const std::string &path,
+              int partitionIndex);
+bool createDirectory(const fs::path &diskPath, const std::string &dirName,
                      int partitionIndex);
-void copyFile(const fs::path &diskPath, const std::string &fileName,
-              const std::string path, int partitionIndex);
-uint64_t findFreeDirectoryEntry(const fs::path &diskPath, uint32_t startRegion,
-                                int sizeAtLeast);
-uint32_t findFreeRegion(const fs::path &diskPath, uint32_t partitionNumber,
-                        std::vector<uint32_t> ignore = {});
-void readFile(const fs::path &diskPath, const std::string &fileName,
-              int partitionIndex, bool hex = false);
-uint32_t findFileInDirectory(const fs::path &diskPath,
-                             const std::string &fileName, uint32_t region);
-void removeFile(const fs::path &diskPath, const std::string &fileName,
+bool copyFile(const fs::path &diskPath, const std::string &fileName,
+              const std::string path, int partitionIndex,
+              ionicfs::FileLayout layout);
+bool writeFile(const fs::path &diskPath, const std::string &fileName,
+               const std::string &path, int partitionIndex, uint64_t offset);
+bool appendFile(const fs::path &diskPath, const std::string &fileName,
+                const std::string &path, int partitionIndex);
+// Copies between images, or partitions of one image. Both locations are
+// written <disk>[:partition]:<path>.
+bool copyBetween(const std::string &from, const std::string &to);
+bool readFile(const fs::path &diskPath, const std::string &fileName,
+              int partitionIndex, bool hex = false, uint64_t offset = 0,
+              std::optional<uint64_t> length = std::nullopt);
+// Reads the files listed one per line in listPath ("-" for stdin) into
+// the directory at outputPath, or with tar into a tar archive there ("-"
+// for stdout).
+bool readManyFiles(const fs::path &diskPath, const fs::path &listPath,
+                   const fs::path &outputPath, bool tar, int partitionIndex);
+bool removeFile(const fs::path &diskPath, const std::string &fileName,
                 int partitionIndex);
-void removeDirectory(const fs::path &diskPath, const std::string &dirName,
+bool removeDirectory(const fs::path &diskPath, const std::string &dirName,
                      int partitionIndex);
-void eliminateEntry(std::fstream &diskFile, uint32_t region,
-                    const std::string &entryName);
-void removeRecursive(const fs::path &diskPath, uint32_t directoryRegion);
-void boot(const fs::path &diskPath, const fs::path &bootPath);
+bool moveEntry(const fs::path &diskPath, const std::string &from,
+               const std::string &to, int partitionIndex);
+bool syncDirectory(const fs::path &hostDirectory, const fs::path &diskPath,
+                   const std::string &imagePath, int partitionIndex,
+                   bool compareHashes);
+// Walk the tree under path with one task per directory on every core,
+// printing results as they are found: the byte size of every directory,
+// or the entries whose name matches the glob pattern.
+bool diskUsage(const fs::path &diskPath, const std::string &path,
+               int partitionIndex);
+bool findEntries(const fs::path &diskPath, const std::string &path,
+                 const std::string &pattern, int partitionIndex);
+bool verifyDirectory(const fs::path &diskPath, const std::string &imagePath,
+                     const fs::path &hostDirectory, int partitionIndex);
+bool commitOverlay(const fs::path &diskPath, const fs::path &overlayPath,
+                   const std::optional<fs::path> &outputPath);
+bool packDisk(const fs::path &diskPath, const fs::path &archivePath);
+bool unpackDisk(const fs::path &archivePath, const fs::path &diskPath);
+// Runs the script lines (stdin without a script) in one transaction.
+bool runBatch(const fs::path &diskPath,
+              const std::optional<fs::path> &scriptPath);
+bool clientCommand(const fs::path &socketPath, const std::string &operation,
+                   const std::vector<std::string> &arguments);
+// Reports leaked regions and bitmap errors of every partition; with repair
+// they are fixed.
+bool checkDisk(const fs::path &diskPath, bool repair);
+// Moves the end of a partition to size regions, or "max" for as far as
+// the next partition or the end of the disk. With diskSize the disk file
+// grows to that many bytes first.
+bool resizePartition(const fs::path &diskPath, int partitionIndex,
+                     const std::string &size,
+                     std::optional<uint64_t> diskSize);
+bool boot(const fs::path &diskPath, const fs::path &bootPath);
 
 #endif // COMMANDS_HPP
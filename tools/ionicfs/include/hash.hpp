@@ -0,0 +1,29 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ionicfs {
+
+// Streaming XXH64, used to compare file contents without keeping both
+// copies around. Produces the same digests as the reference xxHash.
+class ContentHash {
+  public:
+    explicit ContentHash(uint64_t seed = 0);
+    void update(const void *data, std::size_t size);
+    uint64_t digest() const;
+
+  private:
+    uint64_t accumulators[4];
+    uint64_t seed;
+    uint64_t totalLength = 0;
+    unsigned char buffer[32];
+    std::size_t buffered = 0;
+};
+
+uint64_t contentHash(const void *data, std::size_t size);
+
+} // namespace ionicfs
+
+#endif // HASH_HPP
@@ -0,0 +1,44 @@
+#ifndef IO_HPP
+#define IO_HPP
+
+#include "ionicfs.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace ionicfs {
+
+// Positional reads and writes that retry short transfers and EINTR. A
+// short read past the end of the file is an IoError.
+Status readFully(int fd, uint64_t offset, char *buffer, std::size_t size);
+Status writeFully(int fd, uint64_t offset, const char *buffer,
+                  std::size_t size);
+
+// Direct transfers widen the range to DIRECT_ALIGNMENT boundaries and stage
+// it through an aligned bounce buffer of several regions. Blocks only
+// partially covered by a write are read back first.
+constexpr std::size_t DIRECT_ALIGNMENT = 4096;
+constexpr std::size_t DIRECT_BUFFER_SIZE = 128 * 1024;
+
+// open(2) that bypasses the page cache when direct is set (O_DIRECT, or
+// F_NOCACHE where O_DIRECT does not exist).
+int openDisk(const fs::path &path, int flags, bool direct);
+Status readDirect(int fd, uint64_t offset, char *buffer, std::size_t size);
+Status writeDirect(int fd, uint64_t offset, const char *buffer,
+                   std::size_t size);
+
+// Tells the kernel the range will be read soon so it starts fetching it
+// (posix_fadvise WILLNEED, or F_RDADVISE). Only a hint: failures and
+// platforms without either are ignored.
+void adviseWillNeed(int fd, uint64_t offset, uint64_t size);
+
+// flock(2) the whole file, shared or exclusive, polling until timeout runs
+// out. A negative timeout blocks until the lock is granted.
+Status lockFile(int fd, bool exclusive, std::chrono::milliseconds timeout);
+
+// Size of a block device as reported by the driver.
+Status blockDeviceSize(const fs::path &path, std::uintmax_t &size);
+
+} // namespace ionicfs
+
+#endif // IO_HPP
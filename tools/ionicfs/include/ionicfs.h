@@ -0,0 +1,111 @@
+#ifndef IONICFS_H
+#define IONICFS_H
+
+/*
+ * C interface to libionicfs, for tools that cannot use the C++ API (the
+ * Rust host tools link against it through FFI). Images are opaque handles
+ * and every call returns an ionicfs_status.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum ionicfs_status {
+    IONICFS_OK = 0,
+    IONICFS_IMAGE_NOT_FOUND = 1,
+    IONICFS_INVALID_IMAGE = 2,
+    IONICFS_IO_ERROR = 3,
+    IONICFS_READ_ONLY = 4,
+    IONICFS_INVALID_PARTITION = 5,
+    IONICFS_PARTITION_UNUSABLE = 6,
+    IONICFS_NOT_FOUND = 7,
+    IONICFS_NOT_A_DIRECTORY = 8,
+    IONICFS_IS_A_DIRECTORY = 9,
+    IONICFS_ALREADY_EXISTS = 10,
+    IONICFS_INVALID_NAME = 11,
+    IONICFS_INVALID_ARGUMENT = 12,
+    IONICFS_NO_SPACE = 13,
+    IONICFS_CORRUPTED = 14,
+    IONICFS_LOCKED = 15,
+    IONICFS_ABORTED = 16,
+} ionicfs_status;
+
+typedef struct ionicfs_image ionicfs_image;
+
+/* The name is not null-terminated and is only valid during the call that
+ * produced the entry. */
+typedef struct ionicfs_entry {
+    const char *name;
+    size_t name_length;
+    uint64_t last_accessed;
+    uint64_t last_modified;
+    uint64_t created;
+    uint32_t region;
+    int is_directory;
+    /* Zero in listings of disks older than format 005. */
+    uint64_t size;
+} ionicfs_entry;
+
+/* Return non-zero to stop the iteration. */
+typedef int (*ionicfs_entry_callback)(const ionicfs_entry *entry,
+                                      void *context);
+
+const char *ionicfs_status_message(ionicfs_status status);
+
+ionicfs_status ionicfs_open(const char *disk_path, int writable,
+                            ionicfs_image **image);
+/* Layers the disk under a copy-on-write overlay file, see Image::open. */
+ionicfs_status ionicfs_open_overlay(const char *disk_path,
+                                    const char *overlay_path, int writable,
+                                    ionicfs_image **image);
+void ionicfs_close(ionicfs_image *image);
+ionicfs_status ionicfs_commit_overlay(const char *disk_path,
+                                      const char *overlay_path);
+
+ionicfs_status ionicfs_stat(ionicfs_image *image, int partition,
+                            const char *path, ionicfs_entry *entry);
+ionicfs_status ionicfs_list(ionicfs_image *image, int partition,
+                            const char *path, ionicfs_entry_callback callback,
+                            void *context);
+
+/* On success *data is allocated with malloc and released with
+ * ionicfs_free. */
+ionicfs_status ionicfs_read(ionicfs_image *image, int partition,
+                            const char *path, void **data, size_t *size);
+/* Copies up to capacity bytes starting at offset into buffer and stores how
+ * many were read in *size. */
+ionicfs_status ionicfs_read_range(ionicfs_image *image, int partition,
+                                  const char *path, uint64_t offset,
+                                  void *buffer, size_t capacity, size_t *size);
+ionicfs_status ionicfs_write(ionicfs_image *image, int partition,
+                             const char *path, const void *data, size_t size);
+ionicfs_status ionicfs_write_range(ionicfs_image *image, int partition,
+                                   const char *path, uint64_t offset,
+                                   const void *data, size_t size);
+ionicfs_status ionicfs_append(ionicfs_image *image, int partition,
+                              const char *path, const void *data, size_t size);
+ionicfs_status ionicfs_mkdir(ionicfs_image *image, int partition,
+                             const char *path);
+ionicfs_status ionicfs_remove(ionicfs_image *image, int partition,
+                              const char *path);
+ionicfs_status ionicfs_remove_directory(ionicfs_image *image, int partition,
+                                        const char *path);
+/* Moves only the entry: the data stays where it is. */
+ionicfs_status ionicfs_move(ionicfs_image *image, int partition,
+                            const char *from, const char *to);
+/* Groups the calls made until commit or rollback into one transaction, see
+ * ionicfs::Transaction. Closing the image rolls an open one back. */
+ionicfs_status ionicfs_transaction_begin(ionicfs_image *image);
+ionicfs_status ionicfs_transaction_commit(ionicfs_image *image);
+ionicfs_status ionicfs_transaction_rollback(ionicfs_image *image);
+void ionicfs_free(void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IONICFS_H */
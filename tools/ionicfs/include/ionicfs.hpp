@@ -0,0 +1,450 @@
+#ifndef IONICFS_HPP
+#define IONICFS_HPP
+
+#include "arena.hpp"
+#include "layout.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#define IONICFS_VERSION "005"
+
+#define EMPTY_REGION 0x0
+#define DELETED_REGION 0x1
+#define DIRECTORY_REGION 0x2
+#define FILE_REGION 0x3
+#define INDEX_REGION 0x5
+#define BITMAP_REGION 0x6
+#define EXTENT_REGION 0x7
+
+namespace ionicfs {
+
+namespace fs = std::filesystem;
+
+// Result of every library call. Nothing in the library prints: callers
+// decide how to report a failure, statusMessage() gives a readable text.
+enum class Status {
+    Ok = 0,
+    ImageNotFound,
+    InvalidImage,
+    IoError,
+    ReadOnly,
+    InvalidPartition,
+    PartitionUnusable,
+    NotFound,
+    NotADirectory,
+    IsADirectory,
+    AlreadyExists,
+    InvalidName,
+    InvalidArgument,
+    NoSpace,
+    Corrupted,
+    Locked,
+    Aborted,
+};
+
+const char *statusMessage(Status status);
+
+// Seconds since the Unix epoch, as stored in directory entries.
+uint64_t getTime();
+
+struct Partition {
+    char name[18];
+    std::uint32_t partitionRegion;
+    std::uint32_t partitionSize; // in regions
+    bool usable = true;
+} __attribute__((packed));
+
+struct DriveInformation {
+    Partition partitions[4];
+    char bootCode[400];
+    std::uintmax_t diskSize;
+    std::uintmax_t totalRegions;
+    std::uint32_t regionSize;
+    char version[9];
+};
+
+// Names listed into a Directory point into its arena and stay valid until
+// it is destroyed or listed again.
+struct DirectoryEntry {
+    std::string_view name;
+    uint64_t lastAccessed;
+    uint64_t lastModified;
+    uint64_t created;
+    uint32_t region;
+    bool isDirectory;
+    // Byte length of a file. Disks before format 005 do not record it:
+    // stat measures the file there, list and visit leave it at 0.
+    uint64_t size = 0;
+};
+
+struct Directory {
+    uint32_t region;
+    std::vector<DirectoryEntry> entries;
+    std::unique_ptr<DirectoryArena> names = std::make_unique<DirectoryArena>();
+};
+
+// Size in bytes of the disk or image at diskPath.
+Status diskSize(const fs::path &diskPath, std::uintmax_t &size);
+
+struct OpenOptions {
+    // Copy-on-write overlay file, see Image::open.
+    fs::path overlayPath;
+    // Bypass the page cache. The disk size must be a multiple of 4 KiB.
+    bool direct = false;
+    // How long open waits for other processes to release the disk before
+    // failing with Locked. Negative waits forever.
+    std::chrono::milliseconds lockTimeout{-1};
+};
+
+// Writes a fresh preface, an empty root directory and the free-space
+// bitmap for every usable partition. progress is called with the
+// percentage of each partition that has been cleared. Partition starts
+// and sizes count regions of regionSize bytes, one of REGION_SIZES.
+Status format(const fs::path &diskPath,
+              const std::vector<Partition> &partitions,
+              const std::function<void(const Partition &, int)> &progress = {},
+              bool direct = false,
+              std::uint32_t regionSize = DEFAULT_REGION_SIZE);
+
+// Writes every region held by an overlay into the disk it was created
+// over, which then matches what the overlay showed.
+Status commitOverlay(const fs::path &diskPath, const fs::path &overlayPath);
+
+// What check found in a partition.
+struct CheckReport {
+    // Regions reachable from the root directory, which counts itself, plus
+    // the free-space bitmap.
+    uint64_t used = 0;
+    // Regions whose type marks them in use but that nothing references.
+    uint64_t leaked = 0;
+    // Bits of the free-space bitmap that disagree with the walk.
+    uint64_t bitmapErrors = 0;
+};
+
+// How write lays a new file out. A chain links regions that each carry a
+// type byte and a next pointer; an extent file lists runs of bare regions
+// in a header, so reads become a few sequential transfers. Extent files
+// need the free-space bitmap (format 003 on).
+enum class FileLayout { Chain, Extents };
+
+class Overlay;
+class Transaction;
+
+// An open IonicFS disk. Paths are relative to the root directory of the
+// given partition; "" and "/" name the root itself. stat, visit, read and
+// readRange may run on several threads at once; every other call needs
+// the image to itself. Each call that writes is atomic: it runs in its own
+// Transaction, or joins the one the caller opened.
+class Image {
+  public:
+    Image();
+    ~Image();
+    Image(const Image &) = delete;
+    Image &operator=(const Image &) = delete;
+
+    // Readers share a lock on the disk and writers hold it exclusively
+    // until close, so concurrent processes never interleave allocations.
+    // With an overlay path the disk itself is never written: modified
+    // regions go to the overlay file, created on the first writable open,
+    // and reads of the other regions fall through to the disk.
+    Status open(const fs::path &diskPath, bool writable = false,
+                const OpenOptions &options = {});
+    void close();
+    bool isOpen() const { return fd >= 0; }
+    const DriveInformation &information() const { return drive; }
+
+    // Answers from the entry alone on disks that record file sizes.
+    Status stat(int partitionIndex, std::string_view path,
+                DirectoryEntry &entry);
+    Status list(int partitionIndex, std::string_view path,
+                Directory &directory);
+    // Walks a directory without copying names: entries are only valid
+    // inside the visitor, which returns true to stop early.
+    Status visit(int partitionIndex, std::string_view path,
+                 const std::function<bool(const DirectoryEntry &)> &visitor);
+    // Reads stop at the size recorded in the entry. On older disks files
+    // read back padded with zeroes to whole regions.
+    Status read(int partitionIndex, std::string_view path,
+                std::vector<char> &data);
+    // Reads up to length bytes starting at offset. The first access to a
+    // file indexes its region chain, later ones seek straight to the
+    // regions covering the range.
+    Status readRange(int partitionIndex, std::string_view path,
+                     uint64_t offset, uint64_t length, std::vector<char> &data);
+    // Reads many files at once. Every path is resolved and its regions
+    // indexed first; then workers (zero means one per hardware thread)
+    // read the files in order, each asking the kernel to fetch the regions
+    // of the file a window ahead. sink gets every file as it is done, one
+    // call at a time but from any worker, with the status of that file.
+    using ReadSink = std::function<void(std::size_t index, Status status,
+                                        const DirectoryEntry &entry,
+                                        std::vector<char> &data)>;
+    Status readMany(int partitionIndex, const std::vector<std::string> &paths,
+                    const ReadSink &sink, std::size_t workers = 0);
+    Status write(int partitionIndex, std::string_view path, const char *data,
+                 std::size_t size, FileLayout layout = FileLayout::Chain);
+    // Overwrite bytes of an existing file in place. Only the regions
+    // covering the range are rewritten; the file grows with newly
+    // allocated regions when the range ends past the last one.
+    Status writeRange(int partitionIndex, std::string_view path,
+                      uint64_t offset, const char *data, std::size_t size);
+    // Writes after the last byte of the file. On disks whose entries do not
+    // record sizes, trailing zero bytes of the last region count as padding.
+    Status append(int partitionIndex, std::string_view path, const char *data,
+                  std::size_t size);
+    Status mkdir(int partitionIndex, std::string_view path);
+    // Sets the last modification time recorded in the entry.
+    Status touch(int partitionIndex, std::string_view path,
+                 uint64_t lastModified);
+    Status remove(int partitionIndex, std::string_view path);
+    Status removeDirectory(int partitionIndex, std::string_view path);
+    // Moves a file or directory to a new path of the same partition. Only
+    // the entry moves, with its region and timestamps, so the data is not
+    // copied. A directory cannot move into itself.
+    Status move(int partitionIndex, std::string_view from,
+                std::string_view to);
+    // Copies a file or directory tree of source, which may be this image,
+    // to a new path of this one. Files are streamed in chunks and the
+    // writes committed in batches of a few MiB, so a failure removes the
+    // partial copy again unless the caller holds a transaction, which then
+    // buffers the whole tree. Extent files stay extent files when this disk
+    // has a bitmap.
+    Status copy(Image &source, int sourcePartition, std::string_view from,
+                int partitionIndex, std::string_view to);
+    Status setBootCode(const char *data, std::size_t size);
+    // Walks every chain of the partition from its root. With repair,
+    // leaked regions are freed and the free-space bitmap is rebuilt from
+    // the walk. A region reached twice fails with Corrupted.
+    Status check(int partitionIndex, CheckReport &report, bool repair);
+    // Grows the disk file to size bytes. The new regions belong to no
+    // partition until resize hands them out.
+    Status growDisk(std::uintmax_t size);
+    // Moves the end of a partition; its start stays, since every region
+    // pointer is absolute. A partition grows over regions no other
+    // partition holds and shrinks only when the regions it gives up are
+    // free. File data is never moved.
+    Status resize(int partitionIndex, uint32_t partitionSize);
+    // Regions of the free-space bitmap of a partition, in bit order.
+    Status bitmapRegions(int partitionIndex, std::vector<uint32_t> &regions);
+
+    Status readRegion(uint32_t region, char *buffer);
+    // Reads count consecutive regions with a single request.
+    Status readRegions(uint32_t firstRegion, uint32_t count, char *buffer);
+    Status writeRegion(uint32_t region, const char *buffer);
+
+  private:
+    friend class Transaction;
+
+    // The region and offset of an entry, and the first region of the
+    // directory that holds it.
+    struct EntryLocation {
+        uint32_t region = 0;
+        uint32_t offset = 0;
+        uint32_t directory = 0;
+    };
+    // The index marker of a directory and, when header is set, the index
+    // it points to. See layout.hpp.
+    struct DirectoryIndex {
+        uint32_t markerOffset = 0;
+        uint32_t header = 0;
+        uint32_t bucketCount = 0;
+        uint32_t tail = 0;
+        std::vector<uint32_t> tables;
+    };
+    // Returns true to stop the walk. The entry name only lives for the
+    // duration of the call.
+    using EntryVisitor =
+        std::function<bool(const DirectoryEntry &, const EntryLocation &)>;
+    // Gets every region of a chain in order, with its contents; returns
+    // true to stop the walk.
+    using ChainVisitor =
+        std::function<bool(uint32_t region, const char *regionData)>;
+    // The data regions of a file in order. Extent files also keep their
+    // header regions and exact size.
+    struct FileRegions {
+        std::vector<uint32_t> regions;
+        std::vector<uint32_t> headers;
+        uint64_t size = 0;
+        bool extents = false;
+    };
+
+    // Inside a transaction writes are buffered per region and reads see
+    // them; the layers below are the overlay, then the disk.
+    Status readAt(uint64_t offset, char *buffer, std::size_t size);
+    Status writeAt(uint64_t offset, const char *buffer, std::size_t size);
+    Status readLayers(uint64_t offset, char *buffer, std::size_t size);
+    Status writeLayers(uint64_t offset, const char *buffer, std::size_t size);
+    Status bufferWrite(uint64_t offset, const char *buffer, std::size_t size);
+    // Writes extent data, which has no type byte: the caller reserves its
+    // regions in the bitmap.
+    Status writeData(uint64_t offset, const char *buffer, std::size_t size);
+    // Records regions from first on as free before the transaction.
+    void markFresh(const std::vector<uint32_t> &regions, std::size_t first);
+    Status flushPending();
+    // Writes either the fresh regions or all the others.
+    Status flushPending(bool fresh);
+    void discardPending();
+    // Transfers to the disk itself, bypassing the overlay.
+    Status diskRead(uint64_t offset, char *buffer, std::size_t size);
+    Status diskWrite(uint64_t offset, const char *buffer, std::size_t size);
+    // Reads the region size from the disk, before any overlay is layered.
+    Status loadRegionSize();
+    Status loadPreface();
+    Status partitionAt(int partitionIndex, const Partition *&partition);
+    int partitionOf(uint32_t region) const;
+
+    // firstRegion, when given, holds the first region already read.
+    Status forEachEntry(uint32_t directoryRegion, const EntryVisitor &visitor,
+                        const char *firstRegion = nullptr);
+    Status forEachInRegion(uint32_t directoryRegion, uint32_t region,
+                           const char *regionData, const EntryVisitor &visitor,
+                           bool &stopped);
+    Status findEntry(uint32_t directoryRegion, std::string_view name,
+                     DirectoryEntry &entry, EntryLocation &location);
+    Status resolve(int partitionIndex, std::string_view path,
+                   DirectoryEntry &entry, EntryLocation *location = nullptr);
+    Status resolveParent(int partitionIndex, std::string_view path,
+                         uint32_t &parentRegion, std::string_view &name);
+    Status insertEntry(int partitionIndex, uint32_t directoryRegion,
+                       const DirectoryEntry &entry);
+    Status eraseEntry(const EntryLocation &location);
+    Status removeTree(uint32_t directoryRegion);
+    Status copyTree(Image &source, int sourcePartition, std::string_view from,
+                    int partitionIndex, std::string_view to);
+
+    // Hashed directory index, kept up to date by insertEntry and
+    // eraseEntry. loadIndex reads the first region into firstRegion.
+    Status loadIndex(uint32_t directoryRegion, char *firstRegion,
+                     DirectoryIndex &index);
+    Status lookupIndex(uint32_t directoryRegion, const DirectoryIndex &index,
+                       std::string_view name, DirectoryEntry &entry,
+                       EntryLocation &location);
+    Status buildIndex(uint32_t directoryRegion, uint32_t tail,
+                      uint32_t bucketCount, DirectoryIndex &index);
+    Status addToIndex(uint32_t directoryRegion, DirectoryIndex &index,
+                      std::string_view name, uint32_t region);
+    Status removeFromIndex(uint32_t directoryRegion, std::string_view name,
+                           uint32_t region);
+    Status freeIndex(const DirectoryIndex &index);
+
+    // Regions handed out are only reserved once the caller writes them.
+    Status allocateRegions(int partitionIndex, uint32_t count,
+                           std::vector<uint32_t> &regions);
+    Status allocateFromBitmap(int partitionIndex, uint32_t hint,
+                              uint32_t count, std::vector<uint32_t> &regions);
+    // Follows the bitmap regions of a partition into bitmapChains.
+    Status loadBitmap(int partitionIndex);
+    // The two halves of resize, which checks the new bounds first.
+    Status growPartition(int partitionIndex, uint32_t partitionSize);
+    Status shrinkPartition(int partitionIndex, uint32_t partitionSize);
+    // Every write that sets the type byte of a region updates its bit in
+    // the free-space bitmap.
+    Status trackAllocation(uint64_t offset, const char *buffer,
+                           std::size_t size);
+    Status markRegion(uint32_t region, bool used);
+    Status writeChain(const std::vector<uint32_t> &regions, const char *data,
+                      std::size_t size);
+    Status freeChain(uint32_t firstRegion);
+    // Writes data to newly allocated regions, reserves them in the bitmap
+    // and appends them to file. storeExtents then rewrites the headers,
+    // allocating more when the extents no longer fit.
+    Status writeExtents(int partitionIndex, const char *data, std::size_t size,
+                        FileRegions &file);
+    Status storeExtents(int partitionIndex, FileRegions &file);
+    Status freeExtents(const FileRegions &file);
+    // Follows a chain from firstRegion. Regions after the current one are
+    // read with it on the bet that the chain continues there; the window
+    // doubles while the bet pays off and shrinks to the run seen when it
+    // does not.
+    Status walkChain(uint32_t firstRegion, const ChainVisitor &visitor);
+    Status loadFile(uint32_t firstRegion, FileRegions &file);
+    // loadFile, cached by first region.
+    Status chainOf(uint32_t firstRegion, FileRegions *&file);
+    // Copies length bytes from offset, clipped to the end of the file.
+    Status readFile(const FileRegions &file, uint64_t offset, uint64_t length,
+                    std::vector<char> &data);
+    Status contentLength(const FileRegions &file, uint64_t &length);
+    // Hints the kernel that the regions holding the first length bytes of
+    // file are about to be read. Direct I/O skips the page cache, so it
+    // gets no hint.
+    void prefetch(const FileRegions &file, uint64_t length);
+    Status touchEntry(const EntryLocation &location, uint64_t lastModified);
+    // Records the byte length in the entry at location, whose name is
+    // nameLength bytes long. Does nothing on disks without sized entries.
+    Status storeEntrySize(const EntryLocation &location,
+                          std::size_t nameLength, uint64_t size);
+
+    int fd = -1;
+    bool writable = false;
+    bool direct = false;
+    std::unique_ptr<Overlay> overlay;
+    DriveInformation drive{};
+    Geometry geometry = geometryFor(DEFAULT_REGION_SIZE);
+    // Whether partitions keep a free-space bitmap (format 003 on).
+    bool freeBitmap = false;
+    // Bytes after the name of an entry: SIZED_ENTRY_TRAILER_SIZE from
+    // format 005 on, when entries record file sizes.
+    uint32_t entryTrailer = ENTRY_TRAILER_SIZE;
+    uint32_t allocationHint[4] = {};
+    // Bitmap regions of each partition once loadBitmap followed them.
+    std::vector<uint32_t> bitmapChains[4];
+    // Regions from here on were added by growDisk and still read as zeroes.
+    uint64_t zeroedFrom = 0;
+    // Regions of every file indexed so far, keyed by its first region.
+    // Concurrent readers fill it under chainsMutex.
+    std::unordered_map<uint32_t, FileRegions> chains;
+    std::mutex chainsMutex;
+    // Open Transaction scopes and the regions they wrote, keyed by region
+    // and pointing at their copy in pendingData.
+    int transactionDepth = 0;
+    bool transactionAborted = false;
+    uint64_t bufferedWrites = 0;
+    std::map<uint32_t, std::size_t> pendingRegions;
+    std::vector<char> pendingData;
+    // Pending regions that were free when the transaction began. Nothing on
+    // the disk points at them yet, so they are flushed first.
+    std::set<uint32_t> pendingFresh;
+};
+
+// Groups the writes made while it is alive. Regions are buffered in
+// memory; commit() writes the newly allocated regions and syncs them, then
+// rewrites the existing regions that link to them and syncs again. A crash
+// can leave leaked regions but no link to unwritten ones; regions patched
+// in place are not atomic. Scopes nest and only the outermost commit
+// writes. A scope that wrote something and ends without commit rolls the
+// whole transaction back, and its outer scopes then fail with Aborted.
+class Transaction {
+  public:
+    explicit Transaction(Image &image);
+    ~Transaction();
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+
+    Status commit();
+
+  private:
+    Image &image;
+    uint64_t writesAtStart;
+    bool finished = false;
+};
+
+// Compact archive of a disk holding only the regions in use: free and
+// zeroed regions are stored as run lengths. unpack writes a sparse disk
+// image at diskPath where those regions read back as zeroes.
+Status pack(Image &image, std::ostream &archive);
+Status unpack(std::istream &archive, const fs::path &diskPath);
+
+} // namespace ionicfs
+
+#endif // IONICFS_HPP
@@ -0,0 +1,259 @@
+#ifndef LAYOUT_HPP
+#define LAYOUT_HPP
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace ionicfs {
+
+// Integers on disk are little-endian whatever the host. Loads and stores
+// are a single move, plus a byte swap on big-endian hosts.
+template <typename T> constexpr T byteSwap(T value) {
+    T swapped = 0;
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+        swapped = static_cast<T>(swapped << 8) | (value & 0xFF);
+        value >>= 8;
+    }
+    return swapped;
+}
+
+template <typename T> inline T loadLittle(const char *data) {
+    static_assert(std::is_unsigned_v<T>);
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    if constexpr (std::endian::native == std::endian::big) {
+        value = byteSwap(value);
+    }
+    return value;
+}
+
+template <typename T> inline void storeLittle(char *data, T value) {
+    static_assert(std::is_unsigned_v<T>);
+    if constexpr (std::endian::native == std::endian::big) {
+        value = byteSwap(value);
+    }
+    std::memcpy(data, &value, sizeof(T));
+}
+
+inline std::uint32_t loadU32(const char *data) {
+    return loadLittle<std::uint32_t>(data);
+}
+inline std::uint64_t loadU64(const char *data) {
+    return loadLittle<std::uint64_t>(data);
+}
+inline void storeU32(char *data, std::uint32_t value) {
+    storeLittle(data, value);
+}
+inline void storeU64(char *data, std::uint64_t value) {
+    storeLittle(data, value);
+}
+
+// An integer field at a fixed offset of an on-disk record. Records below
+// describe their fields with these, and static_asserts check that they
+// tile the record.
+template <typename T, std::uint32_t Offset> struct Field {
+    static constexpr std::uint32_t offset = Offset;
+    static constexpr std::uint32_t end = Offset + sizeof(T);
+    static T load(const char *record) { return loadLittle<T>(record + Offset); }
+    static void store(char *record, T value) {
+        storeLittle(record + Offset, value);
+    }
+};
+
+// A region is a type byte, its payload and the pointer to the next region
+// of the chain, stored in the last four bytes. Regions are 512 bytes unless
+// the preface records another supported size.
+constexpr std::uint32_t DEFAULT_REGION_SIZE = 512;
+constexpr std::uint32_t REGION_SIZES[] = {512, 4096, 65536};
+
+// The preface fields fill the first 512 bytes of the first region. From
+// format 004 on, the u32 region size follows them; with 512 byte regions it
+// takes the second region, so partitions start after it.
+constexpr std::uint32_t PREFACE_SIZE = 512;
+constexpr std::uint32_t BOOT_CODE_SIZE = 400;
+constexpr std::uint32_t PARTITION_ENTRY_SIZE = 26;
+constexpr std::uint32_t PARTITION_COUNT = 4;
+constexpr std::uint32_t SANITY_OFFSET = 504;
+constexpr std::uint32_t REGION_SIZE_OFFSET = 512;
+constexpr std::uint32_t PREFACE_END = REGION_SIZE_OFFSET + 4;
+
+// Fields of the preface, from the start of the disk, and of a partition
+// entry, from the start of the entry: an 18 byte name, then the first
+// region and the size in regions.
+using PrefaceRegionSize = Field<std::uint32_t, REGION_SIZE_OFFSET>;
+using PartitionStart = Field<std::uint32_t, 18>;
+using PartitionSize = Field<std::uint32_t, 22>;
+
+constexpr std::uint32_t partitionEntryOffset(std::uint32_t index) {
+    return BOOT_CODE_SIZE + index * PARTITION_ENTRY_SIZE;
+}
+
+static_assert(PartitionSize::end == PARTITION_ENTRY_SIZE &&
+              partitionEntryOffset(PARTITION_COUNT) <= SANITY_OFFSET &&
+              PrefaceRegionSize::end == PREFACE_END);
+
+// Directory entries: type, three timestamps, the name with its terminator
+// and the region the entry points to. From format 005 on, the u64 byte
+// length of the file follows the region. Names are limited so an entry
+// fits a region of the smallest size.
+constexpr std::uint32_t ENTRY_HEADER_SIZE = 25;
+constexpr std::uint32_t ENTRY_TRAILER_SIZE = 4;
+constexpr std::uint32_t SIZED_ENTRY_TRAILER_SIZE = ENTRY_TRAILER_SIZE + 8;
+constexpr std::uint32_t MAX_NAME_LENGTH = DEFAULT_REGION_SIZE - 4 - 1 -
+                                          ENTRY_HEADER_SIZE - 1 -
+                                          SIZED_ENTRY_TRAILER_SIZE;
+
+// Fields of an entry, from its type byte, and of its trailer, from the
+// byte after the name terminator.
+using EntryLastAccessed = Field<std::uint64_t, 1>;
+using EntryLastModified = Field<std::uint64_t, 9>;
+using EntryCreated = Field<std::uint64_t, 17>;
+using TrailerRegion = Field<std::uint32_t, 0>;
+using TrailerSize = Field<std::uint64_t, ENTRY_TRAILER_SIZE>;
+
+static_assert(EntryCreated::end == ENTRY_HEADER_SIZE &&
+              TrailerRegion::end == ENTRY_TRAILER_SIZE &&
+              TrailerSize::end == SIZED_ENTRY_TRAILER_SIZE);
+
+// Directory index: the first region of a directory may hold a marker, a
+// deleted entry with an empty name (which no real entry has) whose region
+// points at the index header, or 0 while there is no index. The header
+// holds the bucket count, the last region of the directory chain and the
+// table regions, each pointing at bucket regions. Bucket slots
+// pair the low 32 bits of the XXH64 of a name with the directory region
+// holding the entry; a zero region marks a free slot.
+constexpr std::uint32_t INDEX_BUCKET_COUNT = 1;
+constexpr std::uint32_t INDEX_TAIL = 5;
+constexpr std::uint32_t INDEX_TABLES = 9;
+constexpr std::uint32_t INDEX_SLOT_SIZE = 8;
+// Directories get an index once their chain reaches this many regions.
+constexpr std::uint32_t INDEX_THRESHOLD = 8;
+
+// Extent files: the entry points at a header region holding the exact
+// size of the file, then a count and list of extents, each the first
+// region of a run and its length in regions. Extent regions carry data
+// only, with no type byte or next pointer, so only the free-space bitmap
+// tells they are in use. More header regions follow through the next
+// pointer; only the first records the size.
+constexpr std::uint32_t EXTENT_FILE_SIZE = 1;
+constexpr std::uint32_t EXTENT_COUNT = 9;
+constexpr std::uint32_t EXTENT_LIST = 13;
+constexpr std::uint32_t EXTENT_RECORD_SIZE = 8;
+
+// Offsets and capacities that follow from the region size of a disk.
+struct Geometry {
+    std::uint32_t regionSize;
+    // Bytes between the type byte and the next pointer.
+    std::uint32_t payload;
+    // Offset of the next pointer.
+    std::uint32_t next;
+    // Free-space bitmap, from format 003 on: the regions right after the
+    // root directory of a partition hold one bit per region of the
+    // partition, set while the region is in use. Bits fill the payload,
+    // lowest bit first. A bitmap region whose next pointer is set is
+    // followed by that region instead, as after a partition grows.
+    std::uint32_t bitmapBits;
+    // Bucket pointers per index table, tables per index header and slots
+    // per index bucket.
+    std::uint32_t tableBuckets;
+    std::uint32_t maxTables;
+    std::uint32_t bucketSlots;
+    // Extent records per header region of an extent file.
+    std::uint32_t headerExtents;
+
+    constexpr std::uint64_t offsetOf(std::uint64_t region) const {
+        return region * regionSize;
+    }
+    // The next pointer, in the last four bytes of a region.
+    std::uint32_t nextOf(const char *region) const {
+        return loadU32(region + next);
+    }
+    void setNext(char *region, std::uint32_t value) const {
+        storeU32(region + next, value);
+    }
+    // Regions of a chain holding bytes of data.
+    constexpr std::uint32_t regionsFor(std::size_t bytes) const {
+        return bytes == 0 ? 1 : (bytes + payload - 1) / payload;
+    }
+    constexpr std::uint32_t
+    bitmapRegionsFor(std::uint32_t partitionSize) const {
+        return (partitionSize + bitmapBits - 1) / bitmapBits;
+    }
+    // Regions holding the preface, before the first partition can start.
+    constexpr std::uint32_t prefaceRegions() const {
+        return (PREFACE_END + regionSize - 1) / regionSize;
+    }
+};
+
+constexpr Geometry geometryFor(std::uint32_t regionSize) {
+    const std::uint32_t next = regionSize - 4;
+    return {regionSize,          next - 1,
+            next,                (next - 1) * 8,
+            (next - 1) / 4,      (next - INDEX_TABLES) / 4,
+            (next - 1) / INDEX_SLOT_SIZE,
+            (next - EXTENT_LIST) / EXTENT_RECORD_SIZE};
+}
+
+constexpr bool validRegionSize(std::uint32_t regionSize) {
+    for (std::uint32_t size : REGION_SIZES) {
+        if (size == regionSize) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static_assert(geometryFor(512).payload == 507 &&
+              geometryFor(512).bitmapBits == 4056 &&
+              geometryFor(512).tableBuckets == 126 &&
+              geometryFor(512).bucketSlots == 63 &&
+              geometryFor(512).headerExtents == 61);
+
+// Overlay files: a header block, then groups of a map block followed by one
+// data slot per map entry. Overlays work on 512 byte blocks whatever the
+// region size of the disk.
+constexpr char OVERLAY_MAGIC[] = "IONFSOVL";
+constexpr std::uint32_t OVERLAY_BLOCK_SIZE = 512;
+constexpr std::uint32_t OVERLAY_GROUP_SLOTS = OVERLAY_BLOCK_SIZE / 4;
+
+// Packed archives: a header (magic, region count and byte size of the
+// disk) followed by runs, each a tag byte and a u32 region count. Data runs
+// carry their regions, free runs nothing. An end tag closes the archive.
+// Disks whose regions are not 512 bytes start with a region size tag
+// followed by the u32 size.
+constexpr char PACK_MAGIC[] = "IONFSPAK";
+constexpr std::uint32_t PACK_HEADER_SIZE = 24;
+constexpr char PACK_DATA_RUN = 'D';
+constexpr char PACK_FREE_RUN = 'F';
+constexpr char PACK_REGION_SIZE = 'R';
+constexpr char PACK_END = 'E';
+
+// trailer is ENTRY_TRAILER_SIZE or, on disks with sized entries,
+// SIZED_ENTRY_TRAILER_SIZE.
+constexpr std::uint32_t entrySize(std::size_t nameLength,
+                                  std::uint32_t trailer) {
+    return ENTRY_HEADER_SIZE + nameLength + 1 + trailer;
+}
+
+// Length of the directory entry starting at offset of a region whose next
+// pointer is at next, or 0 if it is malformed.
+inline std::uint32_t entryLength(const char *region, std::uint32_t offset,
+                                 std::uint32_t next, std::uint32_t trailer) {
+    std::uint32_t nameStart = offset + ENTRY_HEADER_SIZE;
+    const void *terminator =
+        std::memchr(region + nameStart, '\0', next - nameStart);
+    if (terminator == nullptr) {
+        return 0;
+    }
+    std::uint32_t nameLength =
+        static_cast<const char *>(terminator) - (region + nameStart);
+    std::uint32_t length = entrySize(nameLength, trailer);
+    return offset + length > next ? 0 : length;
+}
+
+} // namespace ionicfs
+
+#endif // LAYOUT_HPP
@@ -0,0 +1,55 @@
+#ifndef OVERLAY_HPP
+#define OVERLAY_HPP
+
+#include "ionicfs.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+namespace ionicfs {
+
+// Copy-on-write layer holding the regions written over a read-only base
+// image. The file starts with a header region (magic and the number of
+// regions of the base), followed by groups of one map region and
+// OVERLAY_GROUP_SLOTS data slots. Map entries hold the base region stored
+// in the slot plus one, so zero marks a free slot. Slots are only
+// appended, and a map entry is written after the data it describes.
+class Overlay {
+  public:
+    Overlay() = default;
+    ~Overlay();
+    Overlay(const Overlay &) = delete;
+    Overlay &operator=(const Overlay &) = delete;
+
+    // A missing file is created when writable, and is an empty overlay
+    // otherwise. The file is locked like the disk of an Image.
+    Status open(const fs::path &path, uint64_t baseRegions, bool writable,
+                std::chrono::milliseconds lockTimeout);
+    void close();
+
+    bool contains(uint32_t region) const { return slots.count(region) > 0; }
+    std::size_t size() const { return slots.size(); }
+    // Both only touch regions the overlay already holds.
+    Status read(uint32_t region, uint32_t offset, char *buffer,
+                std::size_t size);
+    Status write(uint32_t region, uint32_t offset, const char *buffer,
+                 std::size_t size);
+    // Stores a whole region the overlay does not hold yet.
+    Status add(uint32_t region, const char *data);
+    // Makes every stored region durable.
+    Status sync();
+    // Calls apply for every stored region with its contents.
+    Status forEach(
+        const std::function<Status(uint32_t, const char *)> &apply);
+
+  private:
+    uint64_t mapOffset(uint64_t slot) const;
+    uint64_t slotOffset(uint64_t slot) const;
+
+    int fd = -1;
+    std::unordered_map<uint32_t, uint64_t> slots;
+};
+
+} // namespace ionicfs
+
+#endif // OVERLAY_HPP
@@ -0,0 +1,73 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include "ionicfs.hpp"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ionicfs {
+
+// Binary protocol spoken by ionicfsd over a Unix socket. Every request is
+// an 8 byte header (u32 length of what follows, operation, partition, u16
+// path length), the path and the operation data. Responses are an 8 byte
+// header (u32 payload length, status, three reserved bytes) and the
+// payload. Integers are little-endian like on disk.
+enum class Operation : uint8_t {
+    Stat = 1,
+    List,
+    Read,
+    Write,
+    Mkdir,
+    Remove,
+    RemoveDirectory,
+};
+
+constexpr std::size_t FRAME_HEADER_SIZE = 8;
+// Larger frames are rejected before anything is allocated for them.
+constexpr uint32_t MAX_FRAME_SIZE = 1u << 30;
+
+struct Request {
+    Operation operation = Operation::Stat;
+    uint8_t partition = 0;
+    std::string path;
+    std::vector<char> data;
+};
+
+struct Response {
+    Status status = Status::Ok;
+    std::vector<char> payload;
+};
+
+Status sendRequest(int socket, const Request &request);
+Status receiveRequest(int socket, Request &request);
+Status sendResponse(int socket, Status status, const char *payload,
+                    std::size_t size);
+Status receiveResponse(int socket, Response &response);
+
+// Stat and List payloads are sequences of encoded entries. Decoded names
+// point into the payload.
+void encodeEntry(const DirectoryEntry &entry, std::vector<char> &payload);
+Status decodeEntries(const std::vector<char> &payload,
+                     const std::function<void(const DirectoryEntry &)> &visit);
+
+// Connection to an ionicfsd socket; one request is in flight at a time.
+class Client {
+  public:
+    Client() = default;
+    ~Client();
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    Status connect(const fs::path &socketPath);
+    void close();
+    Status call(const Request &request, Response &response);
+
+  private:
+    int socket = -1;
+};
+
+} // namespace ionicfs
+
+#endif // PROTOCOL_HPP
@@ -0,0 +1,67 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ionicfs {
+
+// Fixed set of worker threads, each with its own task queue. Tasks get the
+// index of the worker running them, so callers can keep state per worker
+// (an Image is not safe to share between threads). A task submitted from a
+// worker goes to that worker's queue, newest first, and idle workers steal
+// the oldest tasks of the others, so recursive work such as walking a tree
+// spreads out without every submit contending for one queue. The pool
+// lock is only taken to put idle workers to sleep and wake them.
+class ThreadPool {
+  public:
+    using Task = std::function<void(std::size_t worker)>;
+
+    // Zero workers means one per hardware thread.
+    explicit ThreadPool(std::size_t workers = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    std::size_t size() const { return threads.size(); }
+    // Safe to call from tasks.
+    void submit(Task task);
+    // Blocks until every submitted task has finished, including the tasks
+    // they submitted.
+    void wait();
+
+  private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(std::size_t worker);
+    bool take(std::size_t worker, Task &task);
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Queue>> queues;
+    // queued counts tasks in the queues, never fewer than they hold, and
+    // pending those not finished. sleeping counts the workers waiting on
+    // available, so submit only takes the lock when one needs waking.
+    std::atomic<std::size_t> queued = 0;
+    std::atomic<std::size_t> pending = 0;
+    std::atomic<std::size_t> sleeping = 0;
+    std::atomic<std::size_t> nextQueue = 0;
+    // Guards stopping and the sleeps on the condition variables.
+    std::mutex mutex;
+    std::condition_variable available;
+    std::condition_variable finished;
+    bool stopping = false;
+};
+
+} // namespace ionicfs
+
+#endif // THREAD_POOL_HPP
@@ -1,8 +1,11 @@
-
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "ionicfs.hpp"
+#include <chrono>
+#include <filesystem>
 #include <string>
+#include <vector>
 
 #define BOLD "\033[1m"
 #define GREEN "\033[32m"
@@ -14,6 +17,24 @@
 std::string trim(const std::string &str);
 bool readYesOrNo(const std::string &prompt);
 std::string unixTimeToString(uint64_t unixTime);
-uint64_t getTime();
 
-#endif // UTILS_H
\ No newline at end of file
+// Prints the message of a failed library call and returns false, so
+// commands can `return report(status);`.
+bool report(ionicfs::Status status);
+// Global options, applied by every later openImage().
+void useOverlay(const std::filesystem::path &overlayPath);
+void useDirectIo();
+void useLockTimeout(std::chrono::milliseconds timeout);
+const ionicfs::OpenOptions &openOptions();
+// Opens the disk for a command, reporting any failure.
+bool openImage(ionicfs::Image &image, const std::filesystem::path &diskPath,
+               bool writable);
+
+// Whether data read back from an image holds a host file of hostSize bytes
+// hashing to hostHash. Files read back at their exact size on disks that
+// record it; otherwise they are padded to whole regions of regionSize bytes
+// with zeroes.
+bool sameContent(uint32_t regionSize, uint64_t hostSize, uint64_t hostHash,
+                 const std::vector<char> &stored);
+
+#endif // UTILS_H
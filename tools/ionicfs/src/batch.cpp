@@ -0,0 +1,118 @@
+#include "commands.hpp"
+#include "utils.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+bool readHostFile(const std::string &fileName, std::vector<char> &buffer) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Unable to open source file at " << fileName
+                  << std::endl;
+        return false;
+    }
+    buffer.assign(std::istreambuf_iterator<char>(file), {});
+    return true;
+}
+
+// Runs one script line: the operation, its arguments and an optional
+// partition index, as in the matching command without the disk path.
+bool runLine(ionicfs::Image &image, const std::vector<std::string> &words) {
+    const std::string &operation = words[0];
+    const bool sendsFile = operation == "copy" || operation == "append";
+    const std::size_t required = sendsFile || operation == "mv" ? 3 : 2;
+    const bool known = sendsFile || operation == "mkdir" ||
+                       operation == "rm" || operation == "rm-dir" ||
+                       operation == "mv";
+    if (!known || words.size() < required || words.size() > required + 1) {
+        std::cerr << "Error: Expected mkdir <dir_name>, copy|append "
+                     "<file_name> <dest_path>, mv <source> <dest_path>, rm "
+                     "<file_name> or rm-dir <dir_name>, then an optional "
+                     "partition index."
+                  << std::endl;
+        return false;
+    }
+    int partitionIndex = 0;
+    if (words.size() > required) {
+        partitionIndex = std::stoi(words[required]);
+    }
+
+    if (sendsFile) {
+        std::vector<char> buffer;
+        if (!readHostFile(words[1], buffer)) {
+            return false;
+        }
+        return report(operation == "copy"
+                          ? image.write(partitionIndex, words[2],
+                                        buffer.data(), buffer.size())
+                          : image.append(partitionIndex, words[2],
+                                         buffer.data(), buffer.size()));
+    }
+    if (operation == "mkdir") {
+        return report(image.mkdir(partitionIndex, words[1]));
+    }
+    if (operation == "rm") {
+        return report(image.remove(partitionIndex, words[1]));
+    }
+    if (operation == "mv") {
+        return report(image.move(partitionIndex, words[1], words[2]));
+    }
+    return report(image.removeDirectory(partitionIndex, words[1]));
+}
+
+} // namespace
+
+bool runBatch(const fs::path &diskPath,
+              const std::optional<fs::path> &scriptPath) {
+    std::ifstream scriptFile;
+    if (scriptPath) {
+        scriptFile.open(*scriptPath);
+        if (!scriptFile) {
+            std::cerr << "Error: Unable to open script at " << *scriptPath
+                      << std::endl;
+            return false;
+        }
+    }
+    std::istream &script = scriptPath ? scriptFile : std::cin;
+
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, true)) {
+        return false;
+    }
+    // Every line joins this transaction: the first failure rolls back all
+    // of them and nothing reaches the disk.
+    ionicfs::Transaction transaction(image);
+    std::string line;
+    int lineNumber = 0;
+    int operations = 0;
+    while (std::getline(script, line)) {
+        lineNumber++;
+        std::istringstream stream(line);
+        std::vector<std::string> words;
+        for (std::string word; stream >> word;) {
+            words.push_back(word);
+        }
+        if (words.empty() || words[0][0] == '#') {
+            continue;
+        }
+        if (!runLine(image, words)) {
+            std::cerr << "Batch rolled back at line " << lineNumber << "."
+                      << std::endl;
+            return false;
+        }
+        operations++;
+    }
+    if (!report(transaction.commit())) {
+        return false;
+    }
+    std::cout << "Batch committed: " << operations << " operations."
+              << std::endl;
+    return true;
+}
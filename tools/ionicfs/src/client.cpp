@@ -0,0 +1,94 @@
+#include "commands.hpp"
+#include "protocol.hpp"
+#include "utils.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct ClientOperation {
+    const char *name;
+    ionicfs::Operation operation;
+    // Whether a host file precedes the image path.
+    bool sendsFile;
+};
+
+constexpr ClientOperation operations[] = {
+    {"stat", ionicfs::Operation::Stat, false},
+    {"list", ionicfs::Operation::List, false},
+    {"read", ionicfs::Operation::Read, false},
+    {"write", ionicfs::Operation::Write, true},
+    {"mkdir", ionicfs::Operation::Mkdir, false},
+    {"rm", ionicfs::Operation::Remove, false},
+    {"rm-dir", ionicfs::Operation::RemoveDirectory, false},
+};
+
+void printEntry(const ionicfs::DirectoryEntry &entry) {
+    std::cout << entry.name << (entry.isDirectory ? "/" : "")
+              << " (Last Modified: " << unixTimeToString(entry.lastModified);
+    if (!entry.isDirectory) {
+        std::cout << ", Size: " << entry.size << " bytes";
+    }
+    std::cout << ", Region: " << std::hex << entry.region << std::dec << ")"
+              << std::endl;
+}
+
+} // namespace
+
+bool clientCommand(const fs::path &socketPath, const std::string &operation,
+                   const std::vector<std::string> &arguments) {
+    const ClientOperation *selected = nullptr;
+    for (const auto &candidate : operations) {
+        if (operation == candidate.name) {
+            selected = &candidate;
+        }
+    }
+    const std::size_t required = selected && selected->sendsFile ? 2 : 1;
+    if (selected == nullptr || arguments.size() < required) {
+        std::cerr << "Usage: ionicfs client <socket_path> "
+                     "<stat|list|read|mkdir|rm|rm-dir> <path> "
+                     "[partition_index]"
+                  << std::endl;
+        std::cerr << "       ionicfs client <socket_path> write <file_name> "
+                     "<path> [partition_index]"
+                  << std::endl;
+        return false;
+    }
+
+    ionicfs::Request request;
+    request.operation = selected->operation;
+    request.path = arguments[required - 1];
+    if (arguments.size() > required) {
+        request.partition =
+            static_cast<uint8_t>(std::stoi(arguments[required]));
+    }
+    if (selected->sendsFile) {
+        std::ifstream source(arguments[0], std::ios::binary);
+        if (!source) {
+            std::cerr << "Error: Unable to open source file at "
+                      << arguments[0] << std::endl;
+            return false;
+        }
+        request.data.assign(std::istreambuf_iterator<char>(source), {});
+    }
+
+    ionicfs::Client client;
+    ionicfs::Response response;
+    if (!report(client.connect(socketPath)) ||
+        !report(client.call(request, response)) || !report(response.status)) {
+        return false;
+    }
+    if (request.operation == ionicfs::Operation::Read) {
+        std::cout.write(response.payload.data(), response.payload.size());
+        std::cout.flush();
+    } else if (request.operation == ionicfs::Operation::Stat ||
+               request.operation == ionicfs::Operation::List) {
+        return report(ionicfs::decodeEntries(response.payload, printEntry));
+    }
+    return true;
+}
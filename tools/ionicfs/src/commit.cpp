@@ -0,0 +1,27 @@
+#include "commands.hpp"
+#include "utils.hpp"
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+bool commitOverlay(const fs::path &diskPath, const fs::path &overlayPath,
+                   const std::optional<fs::path> &outputPath) {
+    fs::path target = diskPath;
+    if (outputPath) {
+        std::error_code error;
+        fs::copy_file(diskPath, *outputPath,
+                      fs::copy_options::overwrite_existing, error);
+        if (error) {
+            std::cerr << "Error: Unable to copy " << diskPath << " to "
+                      << *outputPath << ": " << error.message() << std::endl;
+            return false;
+        }
+        target = *outputPath;
+    }
+    if (!report(ionicfs::commitOverlay(target, overlayPath))) {
+        return false;
+    }
+    std::cout << "Overlay committed into " << target << "." << std::endl;
+    return true;
+}
@@ -4,159 +4,115 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <system_error>
 #include <vector>
-#include <cstring>
-#include <algorithm>
 
 namespace fs = std::filesystem;
 
-void copyFile(const fs::path &diskPath, const std::string &fileName,
-              const std::string path, int partitionIndex) {
-    if (!fs::exists(diskPath)) {
-        std::cerr << "Error: Disk path does not exist." << std::endl;
-        return;
-    }
-
-    if (fs::is_directory(diskPath)) {
-        std::cerr << "Error: Disk path is a directory." << std::endl;
-        return;
-    }
-
-    if (fs::is_empty(diskPath)) {
-        std::cerr << "Error: Disk path is empty." << std::endl;
-        return;
-    }
-
-    std::fstream diskFile(diskPath,
-                          std::ios::in | std::ios::out | std::ios::binary);
-    if (!diskFile) {
-        std::cerr << "Error: Unable to open disk file." << std::endl;
-        return;
-    }
-
-    DriveInformation info = getDriveInformation(diskPath).value();
-    if (partitionIndex < 0 || partitionIndex >= 4) {
-        std::cerr << "Error: Invalid partition index." << std::endl;
-        return;
-    }
-    Partition partition = info.partitions[partitionIndex];
-    if (!partition.usable) {
-        std::cerr << "Error: Partition is not usable." << std::endl;
-        return;
-    }
-
-    // Fix: Properly resolve the source file path
-    fs::path sourceFilePath;
-    try {
-        sourceFilePath = fs::canonical(fs::path(fileName));
-        std::cout << "Resolved source file path: " << sourceFilePath
-                  << std::endl;
-    } catch (const fs::filesystem_error &e) {
-        // If canonical fails (file doesn't exist), try absolute
-        try {
-            sourceFilePath = fs::absolute(fs::path(fileName));
-            std::cout << "Resolved source file path (absolute): "
-                      << sourceFilePath << std::endl;
-        } catch (const fs::filesystem_error &e2) {
-            std::cerr << "Error: Unable to resolve file path: " << fileName
-                      << " - " << e2.what() << std::endl;
-            return;
-        }
-    }
-
-    std::ifstream sourceFile(sourceFilePath, std::ios::binary);
+static bool readSourceFile(const std::string &fileName,
+                           std::vector<char> &buffer) {
+    std::ifstream sourceFile(fileName, std::ios::binary);
     if (!sourceFile) {
-        std::cerr << "Error: Unable to open source file at " << sourceFilePath
+        std::cerr << "Error: Unable to open source file at " << fileName
                   << std::endl;
-        return;
+        return false;
     }
-    std::vector<char> buffer(std::istreambuf_iterator<char>(sourceFile), {});
+    buffer.assign(std::istreambuf_iterator<char>(sourceFile), {});
     sourceFile.close();
     if (buffer.empty()) {
         std::cerr << "Error: Source file is empty." << std::endl;
-        return;
+        return false;
     }
+    return true;
+}
 
-    // Fix: Properly extract directory and filename components using filesystem
-    fs::path destinationPath(path);
-    std::string parentDirectory = destinationPath.parent_path().string();
-    std::string lastComponent = destinationPath.filename().string();
-
-    // Convert to forward slashes for consistency (if needed by your filesystem)
-    std::replace(parentDirectory.begin(), parentDirectory.end(), '\\', '/');
-
-    std::cout << "Parent directory: '" << parentDirectory << "'" << std::endl;
-    std::cout << "File name: '" << lastComponent << "'" << std::endl;
-
-    uint32_t parentRegion =
-        traverseDirectory(diskPath, parentDirectory, partitionIndex);
-    if (parentRegion == 0) {
-        std::cerr << "Error: Unable to find parent directory: "
-                  << parentDirectory << std::endl;
-        return;
+// Splits <disk>[:partition]:<path>. The disk ends at the first colon and
+// a partition is only taken when digits and a colon follow it.
+static bool parseLocation(const std::string &location, fs::path &diskPath,
+                          int &partitionIndex, std::string &path) {
+    const std::size_t colon = location.find(':');
+    if (colon == std::string::npos || colon == 0) {
+        std::cerr << "Error: Expected <disk>[:partition]:<path>, got "
+                  << location << std::endl;
+        return false;
     }
-
-    int size = 1 + 24 + lastComponent.size() + 1 + 4;
-    uint64_t freeEntry = findFreeDirectoryEntry(diskPath, parentRegion, size);
-    if (freeEntry == 0) {
-        std::cerr << "Error: No free directory entry found." << std::endl;
-        return;
+    diskPath = location.substr(0, colon);
+    path = location.substr(colon + 1);
+    partitionIndex = 0;
+    const std::size_t second = path.find(':');
+    if (second != std::string::npos && second > 0 &&
+        path.find_first_not_of("0123456789") == second) {
+        partitionIndex = std::stoi(path.substr(0, second));
+        path.erase(0, second + 1);
     }
+    return true;
+}
 
-    uint32_t neededRegions = buffer.size() / 507;
-    if (buffer.size() % 507 != 0) {
-        neededRegions++;
+bool copyBetween(const std::string &from, const std::string &to) {
+    fs::path sourceDisk, destDisk;
+    int sourcePartition = 0, destPartition = 0;
+    std::string sourcePath, destPath;
+    if (!parseLocation(from, sourceDisk, sourcePartition, sourcePath) ||
+        !parseLocation(to, destDisk, destPartition, destPath)) {
+        return false;
     }
-    std::cout << "Needed regions: " << neededRegions << std::endl;
-
-    std::vector<uint32_t> freeRegions;
-    for (int i = 0; i < neededRegions; i++) {
-        uint32_t freeRegion =
-            findFreeRegion(diskPath, partitionIndex, freeRegions);
-        if (freeRegion == 0) {
-            std::cerr << "Error: No free region found." << std::endl;
-            return;
-        }
-        freeRegions.push_back(freeRegion);
+    ionicfs::Image dest;
+    if (!openImage(dest, destDisk, true)) {
+        return false;
     }
-    std::cout << "Free regions: ";
-    for (const auto &region : freeRegions) {
-        std::cout << region << " ";
+    // A second handle on the same disk would wait on the lock of the first.
+    std::error_code error;
+    if (fs::equivalent(sourceDisk, destDisk, error)) {
+        return report(dest.copy(dest, sourcePartition, sourcePath,
+                                destPartition, destPath));
     }
-    std::cout << std::endl;
-
-    for (int i = 0; i < neededRegions; i++) {
-        diskFile.seekp(freeRegions[i] * 512);
-
-        char regionData[512] = {0};
-
-        regionData[0] = FILE_REGION;
-
-        size_t dataStart = i * 507;
-        size_t dataSize =
-            std::min(static_cast<size_t>(507), buffer.size() - dataStart);
-
-        std::memcpy(regionData + 1, buffer.data() + dataStart, dataSize);
+    ionicfs::Image source;
+    if (!openImage(source, sourceDisk, false)) {
+        return false;
+    }
+    return report(dest.copy(source, sourcePartition, sourcePath,
+                            destPartition, destPath));
+}
 
-        uint32_t nextRegion = 0;
-        if (i < neededRegions - 1) {
-            nextRegion = freeRegions[i + 1];
-        }
-        std::memcpy(regionData + 508, &nextRegion, sizeof(nextRegion));
+bool copyFile(const fs::path &diskPath, const std::string &fileName,
+              const std::string path, int partitionIndex,
+              ionicfs::FileLayout layout) {
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, true)) {
+        return false;
+    }
+    std::vector<char> buffer;
+    if (!readSourceFile(fileName, buffer)) {
+        return false;
+    }
+    return report(image.write(partitionIndex, path, buffer.data(),
+                              buffer.size(), layout));
+}
 
-        diskFile.write(regionData, 512);
+bool writeFile(const fs::path &diskPath, const std::string &fileName,
+               const std::string &path, int partitionIndex, uint64_t offset) {
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, true)) {
+        return false;
     }
+    std::vector<char> buffer;
+    if (!readSourceFile(fileName, buffer)) {
+        return false;
+    }
+    return report(image.writeRange(partitionIndex, path, offset, buffer.data(),
+                                   buffer.size()));
+}
 
-    diskFile.seekp(freeEntry);
-    char entryType = 0x3; // File entry
-    diskFile.write(&entryType, sizeof(entryType));
-    uint64_t currentTime = getTime();
-    diskFile.write(reinterpret_cast<char *>(&currentTime), sizeof(currentTime));
-    diskFile.write(reinterpret_cast<char *>(&currentTime), sizeof(currentTime));
-    diskFile.write(reinterpret_cast<char *>(&currentTime), sizeof(currentTime));
-    diskFile.write(lastComponent.c_str(), lastComponent.size());
-    diskFile.write("\0", 1); // Null terminator for the name
-    uint32_t regionNumber = freeRegions[0];
-    diskFile.write(reinterpret_cast<char *>(&regionNumber),
-                   sizeof(regionNumber));
+bool appendFile(const fs::path &diskPath, const std::string &fileName,
+                const std::string &path, int partitionIndex) {
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, true)) {
+        return false;
+    }
+    std::vector<char> buffer;
+    if (!readSourceFile(fileName, buffer)) {
+        return false;
+    }
+    return report(
+        image.append(partitionIndex, path, buffer.data(), buffer.size()));
 }
@@ -0,0 +1,167 @@
+#include "ionicfs.hpp"
+#include "protocol.hpp"
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <shared_mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Keeps one image open with warm caches and serves requests from many
+// clients. Reads share the image, anything that writes takes it alone.
+
+namespace {
+
+char socketPathToRemove[sizeof(sockaddr_un::sun_path)];
+
+void stop(int) {
+    ::unlink(socketPathToRemove);
+    _exit(0);
+}
+
+ionicfs::Status handle(ionicfs::Image &image, std::shared_mutex &imageLock,
+                       const ionicfs::Request &request,
+                       std::vector<char> &payload) {
+    using ionicfs::Operation;
+    const int partition = request.partition;
+    const std::string &path = request.path;
+    switch (request.operation) {
+    case Operation::Stat: {
+        std::shared_lock lock(imageLock);
+        ionicfs::DirectoryEntry entry;
+        ionicfs::Status status = image.stat(partition, path, entry);
+        if (status == ionicfs::Status::Ok) {
+            ionicfs::encodeEntry(entry, payload);
+        }
+        return status;
+    }
+    case Operation::List: {
+        std::shared_lock lock(imageLock);
+        return image.visit(partition, path,
+                           [&](const ionicfs::DirectoryEntry &entry) {
+                               ionicfs::encodeEntry(entry, payload);
+                               return false;
+                           });
+    }
+    case Operation::Read: {
+        std::shared_lock lock(imageLock);
+        return image.read(partition, path, payload);
+    }
+    case Operation::Write: {
+        std::unique_lock lock(imageLock);
+        return image.write(partition, path, request.data.data(),
+                           request.data.size());
+    }
+    case Operation::Mkdir: {
+        std::unique_lock lock(imageLock);
+        return image.mkdir(partition, path);
+    }
+    case Operation::Remove: {
+        std::unique_lock lock(imageLock);
+        return image.remove(partition, path);
+    }
+    case Operation::RemoveDirectory: {
+        std::unique_lock lock(imageLock);
+        return image.removeDirectory(partition, path);
+    }
+    }
+    return ionicfs::Status::InvalidArgument;
+}
+
+void serve(ionicfs::Image &image, std::shared_mutex &imageLock, int client) {
+    ionicfs::Request request;
+    std::vector<char> payload;
+    while (ionicfs::receiveRequest(client, request) == ionicfs::Status::Ok) {
+        payload.clear();
+        ionicfs::Status status = handle(image, imageLock, request, payload);
+        if (ionicfs::sendResponse(client, status, payload.data(),
+                                  payload.size()) != ionicfs::Status::Ok) {
+            break;
+        }
+    }
+    ::close(client);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    ionicfs::OpenOptions options;
+    // A second daemon on the same disk fails instead of queueing.
+    options.lockTimeout = std::chrono::milliseconds(0);
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--overlay") == 0 && i + 1 < argc) {
+            options.overlayPath = argv[++i];
+        } else if (strcmp(argv[i], "--direct") == 0) {
+            options.direct = true;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+    if (positional.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--overlay <overlay_path>] [--direct] <disk_path> "
+                     "[socket_path]"
+                  << std::endl;
+        return 1;
+    }
+    const fs::path diskPath = positional[0];
+    const fs::path socketPath =
+        positional.size() > 1 ? fs::path(positional[1])
+                              : fs::path(positional[0] + ".sock");
+
+    ionicfs::Image image;
+    ionicfs::Status status = image.open(diskPath, true, options);
+    if (status != ionicfs::Status::Ok) {
+        std::cerr << "Error: " << ionicfs::statusMessage(status) << "."
+                  << std::endl;
+        return 1;
+    }
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.native().size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Socket path is too long." << std::endl;
+        return 1;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    std::strcpy(socketPathToRemove, socketPath.c_str());
+
+    // The disk lock is held, so a socket left at this path is stale.
+    ::unlink(socketPath.c_str());
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 ||
+        ::bind(listener, reinterpret_cast<sockaddr *>(&address),
+               sizeof(address)) != 0 ||
+        ::listen(listener, SOMAXCONN) != 0) {
+        std::cerr << "Error: Unable to listen on " << socketPath << ": "
+                  << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+    std::cout << "Serving " << diskPath << " on " << socketPath << "."
+              << std::endl;
+
+    std::shared_mutex imageLock;
+    while (true) {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cerr << "Error: accept failed: " << std::strerror(errno)
+                      << std::endl;
+            stop(0);
+        }
+        std::thread(serve, std::ref(image), std::ref(imageLock), client)
+            .detach();
+    }
+}
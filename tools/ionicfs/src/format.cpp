@@ -2,7 +2,6 @@
 #include "commands.hpp"
 #include "utils.hpp"
 #include <filesystem>
-#include <fstream>
 #include <iostream>
 #include <string>
 #include <cstring>
@@ -10,37 +9,24 @@
 
 namespace fs = std::filesystem;
 
-void formatDisk(const fs::path &diskPath) {
-    if (!fs::exists(diskPath)) {
-        std::cerr << "Error: Disk path does not exist." << std::endl;
-        return;
+bool formatDisk(const fs::path &diskPath, uint32_t regionSize) {
+    if (!ionicfs::validRegionSize(regionSize)) {
+        std::cerr << "Error: Region size must be 512, 4096 or 65536 bytes."
+                  << std::endl;
+        return false;
     }
-
-    if (fs::is_directory(diskPath)) {
-        std::cerr << "Error: Disk path is a directory." << std::endl;
-        return;
-    }
-
-    if (fs::is_empty(diskPath)) {
-        std::cerr << "Error: Disk path is empty." << std::endl;
-        return;
-    }
-
-    std::fstream diskFile(diskPath,
-                          std::ios::in | std::ios::out | std::ios::binary);
-    if (!diskFile) {
-        std::cerr << "Error: Unable to open disk file." << std::endl;
-        return;
+    std::uintmax_t diskSize = 0;
+    if (!report(ionicfs::diskSize(diskPath, diskSize))) {
+        return false;
     }
-
-    std::uintmax_t diskSize = fs::file_size(diskPath);
     std::cout << "Disk size: " << diskSize << " bytes" << std::endl;
 
-    std::uintmax_t sectorSize = 512;
+    std::uintmax_t sectorSize = regionSize;
     std::uintmax_t totalSectors = diskSize / sectorSize;
+    std::cout << "Region size: " << regionSize << " bytes" << std::endl;
     std::cout << "Total regions: " << totalSectors << std::endl;
 
-    std::vector<Partition> partitions = {};
+    std::vector<ionicfs::Partition> partitions = {};
     std::vector<std::string> partitionNames = {};
 
     std::string partition1;
@@ -49,12 +35,12 @@ void formatDisk(const fs::path &diskPath) {
     std::getline(std::cin, partition1);
     if (trim(partition1).empty()) {
         std::cerr << "Error: Partition name cannot be empty." << std::endl;
-        return;
+        return false;
     }
 
     if (partition1.length() > 17) {
         std::cerr << "Error: Partition name is too long." << std::endl;
-        return;
+        return false;
     } else if (partition1.length() < 17) {
         int remainingSpaces = 17 - partition1.length();
         partition1.append(remainingSpaces, ' ');
@@ -74,7 +60,7 @@ void formatDisk(const fs::path &diskPath) {
 
         if (partitionName.length() > 17) {
             std::cerr << "Error: Partition name is too long." << std::endl;
-            return;
+            return false;
         } else if (partitionName.length() < 17) {
             int remainingSpaces = 17 - partitionName.length();
             partitionName.append(remainingSpaces, ' ');
@@ -84,12 +70,16 @@ void formatDisk(const fs::path &diskPath) {
         usedPartitions++;
     }
 
-    const std::uint32_t partitionSize = (totalSectors - 1) / usedPartitions;
+    // Partitions follow the regions holding the preface.
+    const std::uint32_t firstRegion =
+        ionicfs::geometryFor(regionSize).prefaceRegions();
+    const std::uint32_t partitionSize =
+        (totalSectors - firstRegion) / usedPartitions;
     std::cout << "Each partition will be assigned " << partitionSize
               << " sectors." << std::endl;
     bool confirm = readYesOrNo(
         "Are you sure you want to format the disk with these partitions?");
-    int currentRegion = 0x1;
+    std::uint32_t currentRegion = firstRegion;
     if (!confirm) {
         for (int i = 0; i < usedPartitions; i++) {
             std::cout << "Indicate the partition " << trim(partitionNames[i])
@@ -103,9 +93,10 @@ void formatDisk(const fs::path &diskPath) {
                 int percentage = std::stoi(partitionSizeInput);
                 if (percentage < 0 || percentage > 100) {
                     std::cerr << "Error: Invalid percentage." << std::endl;
-                    return;
+                    return false;
                 }
-                currentPartitionSize = ((totalSectors - 1) * percentage) / 100;
+                currentPartitionSize =
+                    ((totalSectors - firstRegion) * percentage) / 100;
             } else {
                 currentPartitionSize = std::stoi(partitionSizeInput);
             }
@@ -114,12 +105,12 @@ void formatDisk(const fs::path &diskPath) {
             if (currentRegion > totalSectors) {
                 std::cerr << "Error: Partition size exceeds disk size."
                           << std::endl;
-                return;
+                return false;
             }
             std::cout << "Partition " << trim(partitionNames[i]) << " gets "
                       << currentPartitionSize << " sectors." << std::endl;
 
-            Partition p;
+            ionicfs::Partition p;
             p.usable = true;
             p.partitionRegion = start;
             p.partitionSize = currentPartitionSize;
@@ -133,9 +124,9 @@ void formatDisk(const fs::path &diskPath) {
             if (currentRegion > totalSectors) {
                 std::cerr << "Error: Partition size exceeds disk size."
                           << std::endl;
-                return;
+                return false;
             }
-            Partition p;
+            ionicfs::Partition p;
             p.usable = true;
             p.partitionRegion = start;
             p.partitionSize = partitionSize;
@@ -145,7 +136,7 @@ void formatDisk(const fs::path &diskPath) {
     }
 
     for (int i = 0; i < 4 - usedPartitions; i++) {
-        Partition p;
+        ionicfs::Partition p;
         p.usable = false;
         p.partitionRegion = 0;
         p.partitionSize = 0;
@@ -153,65 +144,16 @@ void formatDisk(const fs::path &diskPath) {
         partitions.push_back(p);
     }
 
-    char bootCode[400] = {0};
-    diskFile.write(bootCode, sizeof(bootCode));
-    for (const Partition &partition : partitions) {
-        if (partition.usable) {
-            diskFile.write(partition.name, 18);
-            diskFile.write(
-                reinterpret_cast<const char *>(&partition.partitionRegion), 4);
-            diskFile.write(
-                reinterpret_cast<const char *>(&partition.partitionSize), 4);
-        } else {
-            char empty[26] = {0}; // 18 + 4 + 4 = 26
-            diskFile.write(empty, sizeof(empty));
-        }
-    }
-    diskFile.write("IONFS", 5);
-    diskFile.write(reinterpret_cast<const char *>(&IONICFS_VERSION),
-                   sizeof(IONICFS_VERSION));
-    for (const Partition &partition : partitions) {
-        if (!partition.usable) {
-            continue;
-        }
-        const int partitionRoot = partition.partitionRegion;
-        diskFile.seekp(partitionRoot * sectorSize);
-        char directoryRegion = DIRECTORY_REGION;
-        diskFile.write(&directoryRegion, 1);
-        std::uintmax_t offset = 1;
-        char emptyRegion[512] = {EMPTY_REGION};
-        diskFile.write(&directoryRegion, 1);
-
-        char time[8] = {0};
-        std::uint64_t currentTime = getTime();
-        std::memcpy(time, &currentTime, sizeof(currentTime));
-        diskFile.write(time, sizeof(time));
-        diskFile.write(time, sizeof(time));
-        diskFile.write(time, sizeof(time));
-        diskFile.write(".\0", 2);
-
-        char partitionEntry[4] = {0};
-        partitionEntry[0] = partition.partitionRegion;
-        partitionEntry[1] = partition.partitionRegion >> 8;
-        partitionEntry[2] = partition.partitionRegion >> 16;
-        partitionEntry[3] = partition.partitionRegion >> 24;
-        diskFile.write(partitionEntry, 4);
-
-        while (offset < partition.partitionSize * sectorSize) {
-            diskFile.write(emptyRegion, 1);
-            int percentage =
-                (100 * offset) / (partition.partitionSize * sectorSize);
-            if (percentage % 25 == 0) {
-                std::cout << "\r" << BOLD << GREEN << "Formatting partition "
-                          << trim(partition.name) << ": " << percentage
-                          << "% done." << RESET << std::flush;
-            }
-            offset++;
-        }
+    auto progress = [](const ionicfs::Partition &partition, int percentage) {
         std::cout << "\r" << BOLD << GREEN << "Formatting partition "
-                  << trim(partition.name) << ": " << "100"
-                  << "% done." << RESET << std::endl;
-        std::cout << "Partition " << trim(partition.name)
-                  << " formatted successfully." << std::endl;
-    }
+                  << trim(partition.name) << ": " << percentage << "% done."
+                  << RESET << std::flush;
+        if (percentage == 100) {
+            std::cout << std::endl;
+            std::cout << "Partition " << trim(partition.name)
+                      << " formatted successfully." << std::endl;
+        }
+    };
+    return report(ionicfs::format(diskPath, partitions, progress,
+                                  openOptions().direct, regionSize));
 }
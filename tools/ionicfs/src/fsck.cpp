@@ -0,0 +1,43 @@
+#include "commands.hpp"
+#include "utils.hpp"
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+bool checkDisk(const fs::path &diskPath, bool repair) {
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, repair)) {
+        return false;
+    }
+    bool clean = true;
+    for (int i = 0; i < 4; i++) {
+        const ionicfs::Partition &partition =
+            image.information().partitions[i];
+        if (!partition.usable) {
+            continue;
+        }
+        ionicfs::CheckReport result;
+        std::cout << BOLD << "Partition " << i << " (" << trim(partition.name)
+                  << "): " << RESET;
+        ionicfs::Status status = image.check(i, result, repair);
+        if (status != ionicfs::Status::Ok) {
+            std::cout << std::endl;
+            report(status);
+            clean = false;
+            continue;
+        }
+        std::cout << result.used << " regions in use, " << result.leaked
+                  << " leaked, " << result.bitmapErrors << " bitmap errors."
+                  << std::endl;
+        const bool damaged = result.leaked > 0 || result.bitmapErrors > 0;
+        if (damaged && repair) {
+            std::cout << GREEN << "Repaired: leaked regions freed and bitmap "
+                                  "rebuilt."
+                      << RESET << std::endl;
+        }
+        clean = clean && (!damaged || repair);
+    }
+    return clean;
+}
@@ -0,0 +1,18 @@
+#include "arena.hpp"
+#include <cstring>
+
+// Sized so a typical directory chain fits in the first block.
+static constexpr std::size_t initialBlockSize = 64 * 1024;
+
+DirectoryArena::DirectoryArena() : pool(initialBlockSize) {}
+
+std::string_view DirectoryArena::intern(const char *data, std::size_t length) {
+    if (length == 0) {
+        return {};
+    }
+    char *storage = static_cast<char *>(pool.allocate(length, 1));
+    std::memcpy(storage, data, length);
+    return {storage, length};
+}
+
+void DirectoryArena::release() { pool.release(); }
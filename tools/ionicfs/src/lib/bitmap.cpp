@@ -0,0 +1,173 @@
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace ionicfs {
+
+Status Image::allocateFromBitmap(int partitionIndex, uint32_t hint,
+                                 uint32_t count,
+                                 std::vector<uint32_t> &regions) {
+    // Bitmap regions are read a batch at a time, starting at the bit of
+    // the hint and wrapping around once. Fully used bytes are skipped whole.
+    const uint32_t batchRegions =
+        std::max<uint32_t>(1, 65536 / geometry.regionSize);
+    const uint32_t bits = geometry.bitmapBits;
+    const Partition &partition = drive.partitions[partitionIndex];
+    const uint32_t size = partition.partitionSize;
+    const uint32_t bitmapRegions = geometry.bitmapRegionsFor(size);
+    std::vector<char> batch(batchRegions * geometry.regionSize);
+    Status status = loadBitmap(partitionIndex);
+    if (status != Status::Ok) {
+        return status;
+    }
+    const std::vector<uint32_t> &bitmap = bitmapChains[partitionIndex];
+
+    std::size_t first = regions.size();
+    uint32_t index = hint - partition.partitionRegion;
+    uint32_t scanned = 0;
+    while (regions.size() - first < count && scanned < size) {
+        if (index >= size) {
+            index = 0;
+        }
+        const uint32_t firstBitmap = index / bits;
+        uint32_t span = 1;
+        while (span < batchRegions && firstBitmap + span < bitmapRegions &&
+               bitmap[firstBitmap + span] == bitmap[firstBitmap] + span) {
+            span++;
+        }
+        status = readRegions(bitmap[firstBitmap], span, batch.data());
+        if (status != Status::Ok) {
+            regions.resize(first);
+            return status;
+        }
+        const uint32_t limit = static_cast<uint32_t>(std::min<uint64_t>(
+            size, static_cast<uint64_t>(firstBitmap + span) * bits));
+        while (index < limit && scanned < size &&
+               regions.size() - first < count) {
+            const uint32_t bit = index - firstBitmap * bits;
+            const unsigned char byte =
+                batch[bit / bits * geometry.regionSize + 1 + bit % bits / 8];
+            if (byte == 0xFF && index % 8 == 0 && index + 8 <= limit) {
+                index += 8;
+                scanned += 8;
+                continue;
+            }
+            if ((byte & (1u << (index % 8))) == 0) {
+                regions.push_back(partition.partitionRegion + index);
+            }
+            index++;
+            scanned++;
+        }
+    }
+
+    if (regions.size() - first < count) {
+        regions.resize(first);
+        return Status::NoSpace;
+    }
+    allocationHint[partitionIndex] = regions.back() + 1;
+    return Status::Ok;
+}
+
+Status Image::loadBitmap(int partitionIndex) {
+    std::vector<uint32_t> &bitmap = bitmapChains[partitionIndex];
+    if (!bitmap.empty()) {
+        return Status::Ok;
+    }
+    // Runs of consecutive bitmap regions are read a batch at a time, up to
+    // the region whose next pointer jumps elsewhere.
+    const uint32_t batchRegions =
+        std::max<uint32_t>(1, 65536 / geometry.regionSize);
+    const Partition &partition = drive.partitions[partitionIndex];
+    const uint32_t count = geometry.bitmapRegionsFor(partition.partitionSize);
+    std::vector<char> batch(batchRegions * geometry.regionSize);
+    std::vector<uint32_t> regions;
+    uint32_t region = partition.partitionRegion + 1;
+    while (regions.size() < count) {
+        const uint32_t span = std::min<uint32_t>(
+            batchRegions, count - static_cast<uint32_t>(regions.size()));
+        Status status = readRegions(region, span, batch.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+        uint32_t next = 0;
+        for (uint32_t i = 0; i < span && next == 0; i++) {
+            const char *regionData = batch.data() + i * geometry.regionSize;
+            if (regionData[0] != BITMAP_REGION) {
+                return Status::Corrupted;
+            }
+            regions.push_back(region + i);
+            next = geometry.nextOf(regionData);
+        }
+        region = next != 0 ? next : region + span;
+    }
+    bitmap = std::move(regions);
+    return Status::Ok;
+}
+
+Status Image::bitmapRegions(int partitionIndex,
+                            std::vector<uint32_t> &regions) {
+    const Partition *partition = nullptr;
+    Status status = partitionAt(partitionIndex, partition);
+    if (status == Status::Ok && !freeBitmap) {
+        status = Status::InvalidArgument;
+    }
+    if (status == Status::Ok) {
+        status = loadBitmap(partitionIndex);
+    }
+    if (status == Status::Ok) {
+        regions = bitmapChains[partitionIndex];
+    }
+    return status;
+}
+
+Status Image::trackAllocation(uint64_t offset, const char *buffer,
+                              std::size_t size) {
+    if (!freeBitmap) {
+        return Status::Ok;
+    }
+    // Only the type byte decides whether a region is in use. Bitmap updates
+    // never write one, so they do not come back here.
+    const uint32_t regionSize = geometry.regionSize;
+    for (uint64_t region = (offset + regionSize - 1) / regionSize;
+         region * regionSize < offset + size; region++) {
+        const char type = buffer[region * regionSize - offset];
+        Status status = markRegion(
+            region, type != EMPTY_REGION && type != DELETED_REGION);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    return Status::Ok;
+}
+
+Status Image::markRegion(uint32_t region, bool used) {
+    const int partitionIndex = partitionOf(region);
+    if (partitionIndex < 0) {
+        return Status::Ok;
+    }
+    Status status = loadBitmap(partitionIndex);
+    if (status != Status::Ok) {
+        return status;
+    }
+    const uint32_t start = drive.partitions[partitionIndex].partitionRegion;
+    const uint32_t index = region - start;
+    const uint64_t byteOffset =
+        geometry.offsetOf(
+            bitmapChains[partitionIndex][index / geometry.bitmapBits]) +
+        1 + index % geometry.bitmapBits / 8;
+    const char mask = static_cast<char>(1u << (index % 8));
+    char byte = 0;
+    status = readAt(byteOffset, &byte, 1);
+    if (status != Status::Ok) {
+        return status;
+    }
+    const char updated = used ? byte | mask : byte & ~mask;
+    if (updated == byte) {
+        return Status::Ok;
+    }
+    return writeAt(byteOffset, &updated, 1);
+}
+
+} // namespace ionicfs
@@ -0,0 +1,103 @@
+#include "io.hpp"
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace ionicfs {
+
+void Image::prefetch(const FileRegions &file, uint64_t length) {
+    if (direct || length == 0) {
+        return;
+    }
+    const uint32_t payload =
+        file.extents ? geometry.regionSize : geometry.payload;
+    const std::size_t count = std::min<std::size_t>(
+        file.regions.size(), (length + payload - 1) / payload);
+    const std::vector<uint32_t> &regions = file.regions;
+    std::size_t i = 0;
+    while (i < count) {
+        std::size_t span = 1;
+        while (i + span < count && regions[i + span] == regions[i] + span) {
+            span++;
+        }
+        adviseWillNeed(fd, geometry.offsetOf(regions[i]),
+                       span * uint64_t{geometry.regionSize});
+        i += span;
+    }
+}
+
+Status Image::readMany(int partitionIndex,
+                       const std::vector<std::string> &paths,
+                       const ReadSink &sink, std::size_t workers) {
+    struct Job {
+        DirectoryEntry entry;
+        Status status = Status::Ok;
+        FileRegions *file = nullptr;
+        uint64_t length = 0;
+    };
+    // Resolving up front fills the chain cache, so workers only read data.
+    std::vector<Job> jobs(paths.size());
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        Job &job = jobs[i];
+        job.status = resolve(partitionIndex, paths[i], job.entry);
+        if (job.status == Status::Ok && job.entry.isDirectory) {
+            job.status = Status::IsADirectory;
+        }
+        if (job.status == Status::Ok) {
+            job.status = chainOf(job.entry.region, job.file);
+        }
+        if (job.status != Status::Ok) {
+            continue;
+        }
+        // Same lengths as read: exact where the disk records them, whole
+        // regions otherwise.
+        if (job.file->extents) {
+            job.length = job.file->size;
+        } else if (entryTrailer == SIZED_ENTRY_TRAILER_SIZE) {
+            job.length = job.entry.size;
+        } else {
+            job.length = job.file->regions.size() * uint64_t{geometry.payload};
+        }
+    }
+
+    ThreadPool pool(workers);
+    const std::size_t window = pool.size();
+    auto prefetchJob = [&](std::size_t i) {
+        if (i < jobs.size() && jobs[i].status == Status::Ok) {
+            prefetch(*jobs[i].file, jobs[i].length);
+        }
+    };
+    for (std::size_t i = 0; i < window; i++) {
+        prefetchJob(i);
+    }
+
+    // Workers take files in order, so the hint for file i + window goes
+    // out while the files before it are still being read.
+    std::atomic<std::size_t> next{0};
+    std::mutex sinkMutex;
+    for (std::size_t w = 0; w < window; w++) {
+        pool.submit([&](std::size_t) {
+            std::vector<char> data;
+            for (std::size_t i = next++; i < jobs.size(); i = next++) {
+                prefetchJob(i + window);
+                Job &job = jobs[i];
+                Status status = job.status;
+                if (status == Status::Ok) {
+                    status = readFile(*job.file, 0, job.length, data);
+                }
+                if (status != Status::Ok) {
+                    data.clear();
+                }
+                std::lock_guard lock(sinkMutex);
+                sink(i, status, job.entry, data);
+            }
+        });
+    }
+    pool.wait();
+    return Status::Ok;
+}
+
+} // namespace ionicfs
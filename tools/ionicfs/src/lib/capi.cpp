@@ -0,0 +1,261 @@
+#include "ionicfs.h"
+#include "ionicfs.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+using ionicfs::Status;
+
+static_assert(static_cast<int>(Status::Ok) == IONICFS_OK);
+static_assert(static_cast<int>(Status::ImageNotFound) ==
+              IONICFS_IMAGE_NOT_FOUND);
+static_assert(static_cast<int>(Status::InvalidImage) == IONICFS_INVALID_IMAGE);
+static_assert(static_cast<int>(Status::IoError) == IONICFS_IO_ERROR);
+static_assert(static_cast<int>(Status::ReadOnly) == IONICFS_READ_ONLY);
+static_assert(static_cast<int>(Status::InvalidPartition) ==
+              IONICFS_INVALID_PARTITION);
+static_assert(static_cast<int>(Status::PartitionUnusable) ==
+              IONICFS_PARTITION_UNUSABLE);
+static_assert(static_cast<int>(Status::NotFound) == IONICFS_NOT_FOUND);
+static_assert(static_cast<int>(Status::NotADirectory) ==
+              IONICFS_NOT_A_DIRECTORY);
+static_assert(static_cast<int>(Status::IsADirectory) ==
+              IONICFS_IS_A_DIRECTORY);
+static_assert(static_cast<int>(Status::AlreadyExists) ==
+              IONICFS_ALREADY_EXISTS);
+static_assert(static_cast<int>(Status::InvalidName) == IONICFS_INVALID_NAME);
+static_assert(static_cast<int>(Status::InvalidArgument) ==
+              IONICFS_INVALID_ARGUMENT);
+static_assert(static_cast<int>(Status::NoSpace) == IONICFS_NO_SPACE);
+static_assert(static_cast<int>(Status::Corrupted) == IONICFS_CORRUPTED);
+static_assert(static_cast<int>(Status::Locked) == IONICFS_LOCKED);
+static_assert(static_cast<int>(Status::Aborted) == IONICFS_ABORTED);
+
+struct ionicfs_image {
+    ionicfs::Image image;
+    // Declared after image so it is destroyed, and rolled back, first.
+    std::unique_ptr<ionicfs::Transaction> transaction;
+};
+
+namespace {
+
+ionicfs_status toC(Status status) {
+    return static_cast<ionicfs_status>(status);
+}
+
+void toC(const ionicfs::DirectoryEntry &entry, ionicfs_entry &out) {
+    out.name = entry.name.data();
+    out.name_length = entry.name.size();
+    out.last_accessed = entry.lastAccessed;
+    out.last_modified = entry.lastModified;
+    out.created = entry.created;
+    out.region = entry.region;
+    out.is_directory = entry.isDirectory ? 1 : 0;
+    out.size = entry.size;
+}
+
+} // namespace
+
+extern "C" {
+
+const char *ionicfs_status_message(ionicfs_status status) {
+    return ionicfs::statusMessage(static_cast<Status>(status));
+}
+
+ionicfs_status ionicfs_open(const char *disk_path, int writable,
+                            ionicfs_image **image) {
+    return ionicfs_open_overlay(disk_path, nullptr, writable, image);
+}
+
+ionicfs_status ionicfs_open_overlay(const char *disk_path,
+                                    const char *overlay_path, int writable,
+                                    ionicfs_image **image) {
+    if (disk_path == nullptr || image == nullptr) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    auto *handle = new (std::nothrow) ionicfs_image;
+    if (handle == nullptr) {
+        return IONICFS_IO_ERROR;
+    }
+    ionicfs::OpenOptions options;
+    if (overlay_path != nullptr) {
+        options.overlayPath = overlay_path;
+    }
+    Status status = handle->image.open(disk_path, writable != 0, options);
+    if (status != Status::Ok) {
+        delete handle;
+        return toC(status);
+    }
+    *image = handle;
+    return IONICFS_OK;
+}
+
+void ionicfs_close(ionicfs_image *image) { delete image; }
+
+ionicfs_status ionicfs_commit_overlay(const char *disk_path,
+                                      const char *overlay_path) {
+    if (disk_path == nullptr || overlay_path == nullptr) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    return toC(ionicfs::commitOverlay(disk_path, overlay_path));
+}
+
+ionicfs_status ionicfs_stat(ionicfs_image *image, int partition,
+                            const char *path, ionicfs_entry *entry) {
+    if (image == nullptr || path == nullptr || entry == nullptr) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    ionicfs::DirectoryEntry found;
+    Status status = image->image.stat(partition, path, found);
+    if (status == Status::Ok) {
+        toC(found, *entry);
+    }
+    return toC(status);
+}
+
+ionicfs_status ionicfs_list(ionicfs_image *image, int partition,
+                            const char *path, ionicfs_entry_callback callback,
+                            void *context) {
+    if (image == nullptr || path == nullptr || callback == nullptr) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    return toC(image->image.visit(
+        partition, path, [&](const ionicfs::DirectoryEntry &entry) {
+            ionicfs_entry out;
+            toC(entry, out);
+            return callback(&out, context) != 0;
+        }));
+}
+
+ionicfs_status ionicfs_read(ionicfs_image *image, int partition,
+                            const char *path, void **data, size_t *size) {
+    if (image == nullptr || path == nullptr || data == nullptr ||
+        size == nullptr) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    std::vector<char> buffer;
+    Status status = image->image.read(partition, path, buffer);
+    if (status != Status::Ok) {
+        return toC(status);
+    }
+    void *copy = std::malloc(buffer.empty() ? 1 : buffer.size());
+    if (copy == nullptr) {
+        return IONICFS_IO_ERROR;
+    }
+    std::memcpy(copy, buffer.data(), buffer.size());
+    *data = copy;
+    *size = buffer.size();
+    return IONICFS_OK;
+}
+
+ionicfs_status ionicfs_read_range(ionicfs_image *image, int partition,
+                                  const char *path, uint64_t offset,
+                                  void *buffer, size_t capacity, size_t *size) {
+    if (image == nullptr || path == nullptr || size == nullptr ||
+        (buffer == nullptr && capacity > 0)) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    std::vector<char> range;
+    Status status =
+        image->image.readRange(partition, path, offset, capacity, range);
+    if (status != Status::Ok) {
+        return toC(status);
+    }
+    if (!range.empty()) {
+        std::memcpy(buffer, range.data(), range.size());
+    }
+    *size = range.size();
+    return IONICFS_OK;
+}
+
+ionicfs_status ionicfs_write(ionicfs_image *image, int partition,
+                             const char *path, const void *data, size_t size) {
+    if (image == nullptr || path == nullptr || (data == nullptr && size > 0)) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    return toC(image->image.write(partition, path,
+                                  static_cast<const char *>(data), size));
+}
+
+ionicfs_status ionicfs_write_range(ionicfs_image *image, int partition,
+                                   const char *path, uint64_t offset,
+                                   const void *data, size_t size) {
+    if (image == nullptr || path == nullptr || (data == nullptr && size > 0)) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    return toC(image->image.writeRange(
+        partition, path, offset, static_cast<const char *>(data), size));
+}
+
+ionicfs_status ionicfs_append(ionicfs_image *image, int partition,
+                              const char *path, const void *data,
+                              size_t size) {
+    if (image == nullptr || path == nullptr || (data == nullptr && size > 0)) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    return toC(image->image.append(partition, path,
+                                   static_cast<const char *>(data), size));
+}
+
+ionicfs_status ionicfs_mkdir(ionicfs_image *image, int partition,
+                             const char *path) {
+    if (image == nullptr || path == nullptr) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    return toC(image->image.mkdir(partition, path));
+}
+
+ionicfs_status ionicfs_remove(ionicfs_image *image, int partition,
+                              const char *path) {
+    if (image == nullptr || path == nullptr) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    return toC(image->image.remove(partition, path));
+}
+
+ionicfs_status ionicfs_remove_directory(ionicfs_image *image, int partition,
+                                        const char *path) {
+    if (image == nullptr || path == nullptr) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    return toC(image->image.removeDirectory(partition, path));
+}
+
+ionicfs_status ionicfs_move(ionicfs_image *image, int partition,
+                            const char *from, const char *to) {
+    if (image == nullptr || from == nullptr || to == nullptr) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    return toC(image->image.move(partition, from, to));
+}
+
+ionicfs_status ionicfs_transaction_begin(ionicfs_image *image) {
+    if (image == nullptr || image->transaction) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    image->transaction = std::make_unique<ionicfs::Transaction>(image->image);
+    return IONICFS_OK;
+}
+
+ionicfs_status ionicfs_transaction_commit(ionicfs_image *image) {
+    if (image == nullptr || !image->transaction) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    Status status = image->transaction->commit();
+    image->transaction.reset();
+    return toC(status);
+}
+
+ionicfs_status ionicfs_transaction_rollback(ionicfs_image *image) {
+    if (image == nullptr || !image->transaction) {
+        return IONICFS_INVALID_ARGUMENT;
+    }
+    image->transaction.reset();
+    return IONICFS_OK;
+}
+
+void ionicfs_free(void *data) { std::free(data); }
+
+} // extern "C"
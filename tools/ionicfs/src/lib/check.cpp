@@ -0,0 +1,200 @@
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace ionicfs {
+
+Status Image::check(int partitionIndex, CheckReport &report, bool repair) {
+    Transaction transaction(*this);
+    const Partition *partition = nullptr;
+    Status status = partitionAt(partitionIndex, partition);
+    if (status != Status::Ok) {
+        return status;
+    }
+    report = {};
+    const uint32_t start = partition->partitionRegion;
+    const uint32_t size = partition->partitionSize;
+    std::vector<uint32_t> bitmapChain;
+    if (freeBitmap) {
+        status = bitmapRegions(partitionIndex, bitmapChain);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    const uint32_t bitmapCount = static_cast<uint32_t>(bitmapChain.size());
+    std::vector<bool> reachable(size);
+    auto claim = [&](uint32_t region) {
+        if (partitionOf(region) != partitionIndex ||
+            reachable[region - start]) {
+            return Status::Corrupted;
+        }
+        reachable[region - start] = true;
+        report.used++;
+        return Status::Ok;
+    };
+    // Claims every region of a chain, which must all be of the given type.
+    auto claimChain = [&](uint32_t region, char type) {
+        std::vector<char> regionData(geometry.regionSize);
+        while (region != 0) {
+            Status status = claim(region);
+            if (status == Status::Ok) {
+                status = readRegion(region, regionData.data());
+            }
+            if (status == Status::Ok && regionData[0] != type) {
+                status = Status::Corrupted;
+            }
+            if (status != Status::Ok) {
+                return status;
+            }
+            region = geometry.nextOf(regionData.data());
+        }
+        return Status::Ok;
+    };
+    // Extent files claim their headers and every region of their extents,
+    // which have no type byte to check.
+    auto claimFile = [&](uint32_t region) {
+        std::vector<char> regionData(geometry.regionSize);
+        Status status = readRegion(region, regionData.data());
+        if (status != Status::Ok || regionData[0] != EXTENT_REGION) {
+            return status == Status::Ok ? claimChain(region, FILE_REGION)
+                                        : status;
+        }
+        FileRegions file;
+        status = loadFile(region, file);
+        for (const std::vector<uint32_t> *regions :
+             {&file.headers, &file.regions}) {
+            for (std::size_t i = 0; status == Status::Ok && i < regions->size();
+                 i++) {
+                status = claim((*regions)[i]);
+            }
+        }
+        return status;
+    };
+
+    for (uint32_t region : bitmapChain) {
+        status = claim(region);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    std::vector<uint32_t> directories{start};
+    std::vector<uint32_t> files;
+    while (!directories.empty()) {
+        const uint32_t directory = directories.back();
+        directories.pop_back();
+        status = claimChain(directory, DIRECTORY_REGION);
+        if (status != Status::Ok) {
+            return status;
+        }
+
+        std::vector<char> firstRegion(geometry.regionSize);
+        DirectoryIndex index;
+        status = loadIndex(directory, firstRegion.data(), index);
+        if (status != Status::Ok) {
+            return status;
+        }
+        if (index.header != 0) {
+            status = claim(index.header);
+        }
+        for (uint32_t table : index.tables) {
+            std::vector<char> tableData(geometry.regionSize);
+            if (status == Status::Ok) {
+                status = claim(table);
+            }
+            if (status == Status::Ok) {
+                status = readRegion(table, tableData.data());
+            }
+            for (uint32_t i = 0; status == Status::Ok &&
+                                 i < geometry.tableBuckets;
+                 i++) {
+                const uint32_t bucket = loadU32(tableData.data() + 1 + i * 4);
+                status = bucket == 0 ? Status::Ok : claim(bucket);
+            }
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+
+        status = forEachEntry(
+            directory,
+            [&](const DirectoryEntry &entry, const EntryLocation &) {
+                if (entry.name != ".") {
+                    (entry.isDirectory ? directories : files)
+                        .push_back(entry.region);
+                }
+                return false;
+            },
+            firstRegion.data());
+        for (std::size_t i = 0; status == Status::Ok && i < files.size();
+             i++) {
+            status = claimFile(files[i]);
+        }
+        files.clear();
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+
+    // Type bytes are scanned a batch at a time for regions marked in use
+    // that the walk never reached.
+    const uint32_t batchRegions =
+        std::max<uint32_t>(1, 65536 / geometry.regionSize);
+    std::vector<char> batch(batchRegions * geometry.regionSize);
+    std::vector<uint32_t> leaked;
+    for (uint32_t first = 0; first < size; first += batchRegions) {
+        const uint32_t span = std::min(batchRegions, size - first);
+        status = readRegions(start + first, span, batch.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+        for (uint32_t i = 0; i < span; i++) {
+            const char type = batch[i * geometry.regionSize];
+            if (type != EMPTY_REGION && type != DELETED_REGION &&
+                !reachable[first + i]) {
+                leaked.push_back(start + first + i);
+            }
+        }
+    }
+    report.leaked = leaked.size();
+
+    std::vector<char> bitmap(bitmapCount * geometry.regionSize);
+    for (uint32_t i = 0; i < bitmapCount; i++) {
+        status = readRegion(bitmapChain[i],
+                            bitmap.data() + i * geometry.regionSize);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    for (uint32_t index = 0; index < size && bitmapCount > 0; index++) {
+        char &byte = bitmap[index / geometry.bitmapBits * geometry.regionSize +
+                            1 + index % geometry.bitmapBits / 8];
+        const char mask = static_cast<char>(1u << (index % 8));
+        if (((byte & mask) != 0) != reachable[index]) {
+            report.bitmapErrors++;
+            byte ^= mask;
+        }
+    }
+
+    if (!repair) {
+        return Status::Ok;
+    }
+    for (uint32_t region : leaked) {
+        const char deleted = DELETED_REGION;
+        status = writeAt(geometry.offsetOf(region), &deleted, 1);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    for (uint32_t i = 0; i < bitmapCount && report.bitmapErrors > 0; i++) {
+        status = writeAt(geometry.offsetOf(bitmapChain[i]),
+                         bitmap.data() + i * geometry.regionSize,
+                         geometry.regionSize);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    return transaction.commit();
+}
+
+} // namespace ionicfs
@@ -0,0 +1,696 @@
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ionicfs {
+
+namespace {
+
+// Splits a path into its components, dropping empty ones and ".".
+std::vector<std::string_view> splitPath(std::string_view path) {
+    std::vector<std::string_view> components;
+    while (!path.empty()) {
+        std::size_t slash = path.find('/');
+        std::string_view component = path.substr(0, slash);
+        if (!component.empty() && component != ".") {
+            components.push_back(component);
+        }
+        if (slash == std::string_view::npos) {
+            break;
+        }
+        path.remove_prefix(slash + 1);
+    }
+    return components;
+}
+
+bool validName(std::string_view name) {
+    return !name.empty() && name != "." && name.size() <= MAX_NAME_LENGTH &&
+           name.find('/') == std::string_view::npos &&
+           name.find('\0') == std::string_view::npos;
+}
+
+void encodeEntry(char *destination, const DirectoryEntry &entry,
+                 uint32_t trailer) {
+    destination[0] = entry.isDirectory ? DIRECTORY_REGION : FILE_REGION;
+    EntryLastAccessed::store(destination, entry.lastAccessed);
+    EntryLastModified::store(destination, entry.lastModified);
+    EntryCreated::store(destination, entry.created);
+    std::memcpy(destination + ENTRY_HEADER_SIZE, entry.name.data(),
+                entry.name.size());
+    destination[ENTRY_HEADER_SIZE + entry.name.size()] = '\0';
+    char *end = destination + ENTRY_HEADER_SIZE + entry.name.size() + 1;
+    TrailerRegion::store(end, entry.region);
+    if (trailer == SIZED_ENTRY_TRAILER_SIZE) {
+        TrailerSize::store(end, entry.size);
+    }
+}
+
+} // namespace
+
+Status Image::forEachEntry(uint32_t directoryRegion,
+                           const EntryVisitor &visitor,
+                           const char *firstRegion) {
+    std::vector<char> regionData(geometry.regionSize);
+    uint32_t currentRegion = directoryRegion;
+    uint64_t visited = 0;
+
+    while (currentRegion != 0) {
+        if (++visited > drive.totalRegions) {
+            return Status::Corrupted;
+        }
+        const char *data = regionData.data();
+        if (visited == 1 && firstRegion != nullptr) {
+            data = firstRegion;
+        } else {
+            Status status = readRegion(currentRegion, regionData.data());
+            if (status != Status::Ok) {
+                return status;
+            }
+        }
+        bool stopped = false;
+        Status status = forEachInRegion(directoryRegion, currentRegion, data,
+                                        visitor, stopped);
+        if (status != Status::Ok || stopped) {
+            return status;
+        }
+        currentRegion = geometry.nextOf(data);
+    }
+    return Status::Ok;
+}
+
+Status Image::forEachInRegion(uint32_t directoryRegion, uint32_t region,
+                              const char *regionData,
+                              const EntryVisitor &visitor, bool &stopped) {
+    stopped = false;
+    if (regionData[0] != DIRECTORY_REGION) {
+        return Status::NotADirectory;
+    }
+    uint32_t offset = 1;
+    while (offset + ENTRY_HEADER_SIZE <= geometry.next) {
+        char entryType = regionData[offset];
+        if (entryType == EMPTY_REGION) {
+            break;
+        }
+        uint32_t length =
+            entryLength(regionData, offset, geometry.next, entryTrailer);
+        if (length == 0) {
+            return Status::Corrupted;
+        }
+
+        if (entryType == DIRECTORY_REGION || entryType == FILE_REGION) {
+            const char *data = regionData + offset;
+            DirectoryEntry entry;
+            entry.isDirectory = entryType == DIRECTORY_REGION;
+            entry.lastAccessed = EntryLastAccessed::load(data);
+            entry.lastModified = EntryLastModified::load(data);
+            entry.created = EntryCreated::load(data);
+            entry.name = std::string_view(data + ENTRY_HEADER_SIZE,
+                                          length - entrySize(0, entryTrailer));
+            const char *trailer = data + length - entryTrailer;
+            entry.region = TrailerRegion::load(trailer);
+            if (entryTrailer == SIZED_ENTRY_TRAILER_SIZE) {
+                entry.size = TrailerSize::load(trailer);
+            }
+            if (visitor(entry, {region, offset, directoryRegion})) {
+                stopped = true;
+                return Status::Ok;
+            }
+        } else if (entryType != DELETED_REGION) {
+            return Status::Corrupted;
+        }
+        offset += length;
+    }
+    return Status::Ok;
+}
+
+Status Image::findEntry(uint32_t directoryRegion, std::string_view name,
+                        DirectoryEntry &entry, EntryLocation &location) {
+    std::vector<char> firstRegion(geometry.regionSize);
+    DirectoryIndex index;
+    Status status = loadIndex(directoryRegion, firstRegion.data(), index);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (index.header != 0) {
+        return lookupIndex(directoryRegion, index, name, entry, location);
+    }
+
+    bool found = false;
+    status = forEachEntry(
+        directoryRegion,
+        [&](const DirectoryEntry &candidate, const EntryLocation &where) {
+            if (candidate.name != name) {
+                return false;
+            }
+            entry = candidate;
+            entry.name = name;
+            location = where;
+            found = true;
+            return true;
+        },
+        firstRegion.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    return found ? Status::Ok : Status::NotFound;
+}
+
+Status Image::resolve(int partitionIndex, std::string_view path,
+                      DirectoryEntry &entry, EntryLocation *location) {
+    const Partition *partition = nullptr;
+    Status status = partitionAt(partitionIndex, partition);
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    std::vector<std::string_view> components = splitPath(path);
+    EntryLocation where;
+    if (components.empty()) {
+        // The root has no parent; its "." entry carries the timestamps.
+        status = findEntry(partition->partitionRegion, ".", entry, where);
+        if (status == Status::NotFound) {
+            entry = {};
+            status = Status::Ok;
+        }
+        entry.name = "/";
+        entry.region = partition->partitionRegion;
+        entry.isDirectory = true;
+        if (location != nullptr) {
+            *location = {};
+        }
+        return status;
+    }
+
+    uint32_t currentRegion = partition->partitionRegion;
+    for (std::size_t i = 0; i < components.size(); i++) {
+        status = findEntry(currentRegion, components[i], entry, where);
+        if (status != Status::Ok) {
+            return status;
+        }
+        if (partitionOf(entry.region) != partitionIndex) {
+            return Status::Corrupted;
+        }
+        if (i + 1 < components.size() && !entry.isDirectory) {
+            return Status::NotADirectory;
+        }
+        currentRegion = entry.region;
+    }
+    if (location != nullptr) {
+        *location = where;
+    }
+    return Status::Ok;
+}
+
+Status Image::resolveParent(int partitionIndex, std::string_view path,
+                            uint32_t &parentRegion, std::string_view &name) {
+    std::size_t lastSlash = path.find_last_of('/');
+    std::string_view parentPath;
+    if (lastSlash == std::string_view::npos) {
+        name = path;
+    } else {
+        parentPath = path.substr(0, lastSlash);
+        name = path.substr(lastSlash + 1);
+    }
+    if (!validName(name)) {
+        return Status::InvalidName;
+    }
+
+    DirectoryEntry parent;
+    Status status = resolve(partitionIndex, parentPath, parent);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (!parent.isDirectory) {
+        return Status::NotADirectory;
+    }
+    parentRegion = parent.region;
+
+    DirectoryEntry existing;
+    EntryLocation location;
+    status = findEntry(parentRegion, name, existing, location);
+    if (status == Status::Ok) {
+        return Status::AlreadyExists;
+    }
+    return status == Status::NotFound ? Status::Ok : status;
+}
+
+Status Image::insertEntry(int partitionIndex, uint32_t directoryRegion,
+                          const DirectoryEntry &entry) {
+    const uint32_t size = entrySize(entry.name.size(), entryTrailer);
+    std::vector<char> regionData(geometry.regionSize);
+    DirectoryIndex index;
+    Status status = loadIndex(directoryRegion, regionData.data(), index);
+    if (status != Status::Ok) {
+        return status;
+    }
+    // Indexed directories are large: new entries go to the end of the
+    // chain instead of walking it for a deleted entry to reuse.
+    uint32_t currentRegion = directoryRegion;
+    if (index.header != 0 && index.tail != 0) {
+        currentRegion = index.tail;
+    }
+    uint32_t loadedRegion = directoryRegion;
+    uint64_t visited = 0;
+
+    while (true) {
+        if (++visited > drive.totalRegions) {
+            return Status::Corrupted;
+        }
+        if (currentRegion != loadedRegion) {
+            status = readRegion(currentRegion, regionData.data());
+            if (status != Status::Ok) {
+                return status;
+            }
+            loadedRegion = currentRegion;
+        }
+
+        // Entries are appended after the last one, or take the place of a
+        // deleted entry of exactly the same length so no stale bytes remain.
+        uint32_t offset = 1;
+        while (offset + ENTRY_HEADER_SIZE <= geometry.next &&
+               regionData[offset] != EMPTY_REGION) {
+            uint32_t length = entryLength(regionData.data(), offset,
+                                          geometry.next, entryTrailer);
+            if (length == 0) {
+                return Status::Corrupted;
+            }
+            if (regionData[offset] == DELETED_REGION && length == size) {
+                break;
+            }
+            offset += length;
+        }
+        if (offset + size <= geometry.next) {
+            encodeEntry(regionData.data() + offset, entry, entryTrailer);
+            status = writeRegion(currentRegion, regionData.data());
+            if (status != Status::Ok || index.header == 0) {
+                return status;
+            }
+            return addToIndex(directoryRegion, index, entry.name,
+                              currentRegion);
+        }
+
+        uint32_t nextRegion = geometry.nextOf(regionData.data());
+        if (nextRegion == 0) {
+            break;
+        }
+        currentRegion = nextRegion;
+    }
+
+    std::vector<uint32_t> regions;
+    status = allocateRegions(partitionIndex, 1, regions);
+    if (status != Status::Ok) {
+        return status;
+    }
+    std::vector<char> extension(geometry.regionSize);
+    extension[0] = DIRECTORY_REGION;
+    encodeEntry(extension.data() + 1, entry, entryTrailer);
+    status = writeRegion(regions[0], extension.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    geometry.setNext(regionData.data(), regions[0]);
+    status = writeRegion(currentRegion, regionData.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    if (index.header != 0) {
+        char tail[4];
+        storeU32(tail, regions[0]);
+        status = writeAt(geometry.offsetOf(index.header) + INDEX_TAIL, tail,
+                         sizeof(tail));
+        if (status != Status::Ok) {
+            return status;
+        }
+        index.tail = regions[0];
+        return addToIndex(directoryRegion, index, entry.name, regions[0]);
+    }
+    if (index.markerOffset != 0 && visited + 1 >= INDEX_THRESHOLD) {
+        return buildIndex(directoryRegion, regions[0], geometry.tableBuckets,
+                          index);
+    }
+    return Status::Ok;
+}
+
+Status Image::eraseEntry(const EntryLocation &location) {
+    std::vector<char> regionData(geometry.regionSize);
+    Status status = readRegion(location.region, regionData.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    uint32_t length = entryLength(regionData.data(), location.offset,
+                                  geometry.next, entryTrailer);
+    if (length == 0) {
+        return Status::Corrupted;
+    }
+    const char deleted = DELETED_REGION;
+    status =
+        writeAt(geometry.offsetOf(location.region) + location.offset, &deleted,
+                1);
+    if (status != Status::Ok) {
+        return status;
+    }
+    std::string_view name(
+        regionData.data() + location.offset + ENTRY_HEADER_SIZE,
+        length - entrySize(0, entryTrailer));
+    return removeFromIndex(location.directory, name, location.region);
+}
+
+Status Image::stat(int partitionIndex, std::string_view path,
+                   DirectoryEntry &entry) {
+    Status status = resolve(partitionIndex, path, entry);
+    if (status != Status::Ok || entry.isDirectory ||
+        entryTrailer == SIZED_ENTRY_TRAILER_SIZE) {
+        return status;
+    }
+    // Older disks do not record sizes, so the file is measured.
+    FileRegions *file = nullptr;
+    status = chainOf(entry.region, file);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return contentLength(*file, entry.size);
+}
+
+Status Image::visit(
+    int partitionIndex, std::string_view path,
+    const std::function<bool(const DirectoryEntry &)> &visitor) {
+    DirectoryEntry entry;
+    Status status = resolve(partitionIndex, path, entry);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (!entry.isDirectory) {
+        return Status::NotADirectory;
+    }
+    return forEachEntry(entry.region,
+                        [&](const DirectoryEntry &found,
+                            const EntryLocation &) { return visitor(found); });
+}
+
+Status Image::list(int partitionIndex, std::string_view path,
+                   Directory &directory) {
+    DirectoryEntry entry;
+    Status status = resolve(partitionIndex, path, entry);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (!entry.isDirectory) {
+        return Status::NotADirectory;
+    }
+
+    directory.region = entry.region;
+    directory.entries.clear();
+    directory.names->release();
+    return forEachEntry(entry.region, [&](const DirectoryEntry &found,
+                                          const EntryLocation &) {
+        DirectoryEntry &stored = directory.entries.emplace_back(found);
+        stored.name =
+            directory.names->intern(found.name.data(), found.name.size());
+        return false;
+    });
+}
+
+Status Image::mkdir(int partitionIndex, std::string_view path) {
+    Transaction transaction(*this);
+    uint32_t parentRegion = 0;
+    std::string_view name;
+    Status status = resolveParent(partitionIndex, path, parentRegion, name);
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    std::vector<uint32_t> regions;
+    status = allocateRegions(partitionIndex, 1, regions);
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    uint64_t currentTime = getTime();
+    DirectoryEntry entry{name,          currentTime, currentTime,
+                         currentTime,   regions[0],  true};
+    DirectoryEntry self = entry;
+    self.name = ".";
+
+    // "." is followed by the index marker, with no index until the
+    // directory grows large. Readers of older disks stop at a deleted entry
+    // they cannot step over, so directories there never get an index.
+    std::vector<char> regionData(geometry.regionSize);
+    regionData[0] = DIRECTORY_REGION;
+    encodeEntry(regionData.data() + 1, self, entryTrailer);
+    if (entryTrailer == SIZED_ENTRY_TRAILER_SIZE) {
+        regionData[1 + entrySize(1, entryTrailer)] = DELETED_REGION;
+    }
+    status = writeRegion(regions[0], regionData.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    status = insertEntry(partitionIndex, parentRegion, entry);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return transaction.commit();
+}
+
+Status Image::move(int partitionIndex, std::string_view from,
+                   std::string_view to) {
+    Transaction transaction(*this);
+    DirectoryEntry entry;
+    EntryLocation location;
+    Status status = resolve(partitionIndex, from, entry, &location);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (location.region == 0) {
+        return Status::InvalidArgument;
+    }
+    const std::vector<std::string_view> source = splitPath(from);
+    const std::vector<std::string_view> target = splitPath(to);
+    if (entry.isDirectory && target.size() > source.size() &&
+        std::equal(source.begin(), source.end(), target.begin())) {
+        return Status::InvalidArgument;
+    }
+    uint32_t parentRegion = 0;
+    std::string_view name;
+    status = resolveParent(partitionIndex, to, parentRegion, name);
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    DirectoryEntry moved = entry;
+    moved.name = name;
+    status = eraseEntry(location);
+    if (status != Status::Ok) {
+        return status;
+    }
+    status = insertEntry(partitionIndex, parentRegion, moved);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return transaction.commit();
+}
+
+Status Image::copy(Image &source, int sourcePartition, std::string_view from,
+                   int partitionIndex, std::string_view to) {
+    if (&source == this && sourcePartition == partitionIndex) {
+        const std::vector<std::string_view> origin = splitPath(from);
+        const std::vector<std::string_view> target = splitPath(to);
+        if (target.size() > origin.size() &&
+            std::equal(origin.begin(), origin.end(), target.begin())) {
+            return Status::InvalidArgument;
+        }
+    }
+    // The destination must be new, so whatever exists there after a failure
+    // is a partial copy that can be removed again.
+    DirectoryEntry existing;
+    Status status = stat(partitionIndex, to, existing);
+    if (status != Status::NotFound) {
+        return status == Status::Ok ? Status::AlreadyExists : status;
+    }
+
+    status = copyTree(source, sourcePartition, from, partitionIndex, to);
+    // Inside a caller's transaction nothing was committed, and its abort
+    // drops the partial copy instead.
+    if (status != Status::Ok && transactionDepth == 0 &&
+        stat(partitionIndex, to, existing) == Status::Ok) {
+        if (existing.isDirectory) {
+            removeDirectory(partitionIndex, to);
+        } else {
+            remove(partitionIndex, to);
+        }
+    }
+    return status;
+}
+
+Status Image::copyTree(Image &source, int sourcePartition,
+                       std::string_view from, int partitionIndex,
+                       std::string_view to) {
+    // Files are streamed in chunks of whole regions, and the writes are
+    // committed once a batch buffers this much, so memory stays bounded
+    // however large the tree is.
+    constexpr uint64_t chunkBytes = 1 << 20;
+    constexpr std::size_t batchBytes = 4 << 20;
+    std::optional<Transaction> batch;
+    auto checkpoint = [&]() {
+        Status status = Status::Ok;
+        if (batch && pendingData.size() >= batchBytes) {
+            status = batch->commit();
+            batch.reset();
+        }
+        if (!batch) {
+            batch.emplace(*this);
+        }
+        return status;
+    };
+
+    // Directories are created before their contents, so the pending
+    // copies form a stack of source and destination paths.
+    std::vector<std::pair<std::string, std::string>> pending{
+        {std::string(from), std::string(to)}};
+    std::vector<char> data;
+    while (!pending.empty()) {
+        const std::string origin = std::move(pending.back().first);
+        const std::string target = std::move(pending.back().second);
+        pending.pop_back();
+        Status status = checkpoint();
+        DirectoryEntry entry;
+        if (status == Status::Ok) {
+            status = source.stat(sourcePartition, origin, entry);
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+        if (entry.isDirectory) {
+            status = mkdir(partitionIndex, target);
+            if (status == Status::Ok) {
+                status = source.visit(
+                    sourcePartition, origin,
+                    [&](const DirectoryEntry &child) {
+                        if (child.name != ".") {
+                            pending.emplace_back(
+                                origin + "/" + std::string(child.name),
+                                target + "/" + std::string(child.name));
+                        }
+                        return false;
+                    });
+            }
+            if (status != Status::Ok) {
+                return status;
+            }
+            continue;
+        }
+
+        std::vector<char> firstRegion(source.geometry.regionSize);
+        status = source.readRegion(entry.region, firstRegion.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+        const FileLayout layout =
+            firstRegion[0] == EXTENT_REGION && freeBitmap ? FileLayout::Extents
+                                                          : FileLayout::Chain;
+        // Chunks end on a region boundary, which older disks need since
+        // their files only grow by whole regions.
+        const uint64_t payload = layout == FileLayout::Extents
+                                     ? geometry.regionSize
+                                     : geometry.payload;
+        const uint64_t chunk = std::max<uint64_t>(chunkBytes / payload, 1) *
+                               payload;
+        // stat measures files on older disks, where reads pad them.
+        uint64_t offset = 0;
+        do {
+            if (offset > 0) {
+                status = checkpoint();
+            }
+            if (status == Status::Ok) {
+                status = source.readRange(sourcePartition, origin, offset,
+                                          std::min(chunk, entry.size - offset),
+                                          data);
+            }
+            if (status == Status::Ok && data.empty() && offset < entry.size) {
+                status = Status::Corrupted;
+            }
+            if (status != Status::Ok) {
+                return status;
+            }
+            status = offset == 0 ? write(partitionIndex, target, data.data(),
+                                         data.size(), layout)
+                                 : writeRange(partitionIndex, target, offset,
+                                              data.data(), data.size());
+            if (status != Status::Ok) {
+                return status;
+            }
+            offset += data.size();
+        } while (offset < entry.size);
+    }
+    return batch ? batch->commit() : Status::Ok;
+}
+
+Status Image::removeTree(uint32_t directoryRegion) {
+    std::vector<char> firstRegion(geometry.regionSize);
+    DirectoryIndex index;
+    Status status = loadIndex(directoryRegion, firstRegion.data(), index);
+    if (status != Status::Ok) {
+        return status;
+    }
+    std::vector<DirectoryEntry> children;
+    status = forEachEntry(
+        directoryRegion,
+        [&](const DirectoryEntry &entry, const EntryLocation &) {
+            if (entry.name != ".") {
+                children.push_back(entry);
+            }
+            return false;
+        },
+        firstRegion.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (index.header != 0) {
+        status = freeIndex(index);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+
+    for (const DirectoryEntry &child : children) {
+        status = child.isDirectory ? removeTree(child.region)
+                                   : freeChain(child.region);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    return freeChain(directoryRegion);
+}
+
+Status Image::removeDirectory(int partitionIndex, std::string_view path) {
+    Transaction transaction(*this);
+    DirectoryEntry entry;
+    EntryLocation location;
+    Status status = resolve(partitionIndex, path, entry, &location);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (!entry.isDirectory) {
+        return Status::NotADirectory;
+    }
+    if (location.region == 0) {
+        return Status::InvalidArgument;
+    }
+
+    status = eraseEntry(location);
+    if (status != Status::Ok) {
+        return status;
+    }
+    status = removeTree(entry.region);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return transaction.commit();
+}
+
+} // namespace ionicfs
@@ -0,0 +1,718 @@
+#include "io.hpp"
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace ionicfs {
+
+Status Image::writeChain(const std::vector<uint32_t> &regions,
+                         const char *data, std::size_t size) {
+    // Consecutive regions are laid out in one buffer and written together.
+    std::vector<char> run;
+    std::size_t i = 0;
+    while (i < regions.size()) {
+        std::size_t length = 1;
+        while (i + length < regions.size() &&
+               regions[i + length] == regions[i] + length) {
+            length++;
+        }
+
+        run.assign(length * geometry.regionSize, 0);
+        for (std::size_t j = 0; j < length; j++) {
+            char *regionData = run.data() + j * geometry.regionSize;
+            std::size_t dataStart = (i + j) * geometry.payload;
+            std::size_t dataSize =
+                dataStart < size
+                    ? std::min<std::size_t>(geometry.payload, size - dataStart)
+                    : 0;
+            regionData[0] = FILE_REGION;
+            std::memcpy(regionData + 1, data + dataStart, dataSize);
+            uint32_t nextRegion =
+                i + j + 1 < regions.size() ? regions[i + j + 1] : 0;
+            geometry.setNext(regionData, nextRegion);
+        }
+
+        Status status =
+            writeAt(geometry.offsetOf(regions[i]), run.data(), run.size());
+        if (status != Status::Ok) {
+            return status;
+        }
+        i += length;
+    }
+    return Status::Ok;
+}
+
+Status Image::freeChain(uint32_t firstRegion) {
+    chains.erase(firstRegion);
+    std::vector<char> regionData(geometry.regionSize);
+    uint32_t currentRegion = firstRegion;
+    uint64_t visited = 0;
+
+    while (currentRegion != 0) {
+        if (++visited > drive.totalRegions) {
+            return Status::Corrupted;
+        }
+        Status status = readRegion(currentRegion, regionData.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+        if (visited == 1 && regionData[0] == EXTENT_REGION) {
+            FileRegions file;
+            status = loadFile(firstRegion, file);
+            return status == Status::Ok ? freeExtents(file) : status;
+        }
+        const char deleted = DELETED_REGION;
+        status = writeAt(geometry.offsetOf(currentRegion), &deleted, 1);
+        if (status != Status::Ok) {
+            return status;
+        }
+
+        int partitionIndex = partitionOf(currentRegion);
+        if (partitionIndex >= 0 &&
+            currentRegion < allocationHint[partitionIndex]) {
+            allocationHint[partitionIndex] = currentRegion;
+        }
+        currentRegion = geometry.nextOf(regionData.data());
+    }
+    return Status::Ok;
+}
+
+Status Image::writeExtents(int partitionIndex, const char *data,
+                           std::size_t size, FileRegions &file) {
+    const uint32_t regionSize = geometry.regionSize;
+    const uint32_t count =
+        static_cast<uint32_t>((size + regionSize - 1) / regionSize);
+    if (count == 0) {
+        return Status::Ok;
+    }
+    std::vector<uint32_t> regions;
+    Status status = allocateRegions(partitionIndex, count, regions);
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    // Each run of consecutive regions is one write; the last region is
+    // padded with zeroes.
+    std::size_t i = 0;
+    while (i < regions.size()) {
+        std::size_t length = 1;
+        while (i + length < regions.size() &&
+               regions[i + length] == regions[i] + length) {
+            length++;
+        }
+        const uint64_t start = i * uint64_t{regionSize};
+        const uint64_t bytes = std::min<uint64_t>(
+            length * uint64_t{regionSize}, size - start);
+        const uint64_t whole = bytes / regionSize * regionSize;
+        const uint64_t offset = geometry.offsetOf(regions[i]);
+        status = whole == 0 ? Status::Ok
+                            : writeData(offset, data + start, whole);
+        if (status == Status::Ok && whole < bytes) {
+            std::vector<char> last(regionSize, 0);
+            std::memcpy(last.data(), data + start + whole, bytes - whole);
+            status = writeData(offset + whole, last.data(), last.size());
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+        i += length;
+    }
+    for (uint32_t region : regions) {
+        status = markRegion(region, true);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    file.regions.insert(file.regions.end(), regions.begin(), regions.end());
+    return Status::Ok;
+}
+
+Status Image::storeExtents(int partitionIndex, FileRegions &file) {
+    std::vector<std::pair<uint32_t, uint32_t>> extents;
+    for (uint32_t region : file.regions) {
+        if (!extents.empty() &&
+            extents.back().first + extents.back().second == region) {
+            extents.back().second++;
+        } else {
+            extents.push_back({region, 1});
+        }
+    }
+    const uint32_t perHeader = geometry.headerExtents;
+    const std::size_t needed = std::max<std::size_t>(
+        1, (extents.size() + perHeader - 1) / perHeader);
+    if (file.headers.size() < needed) {
+        Status status = allocateRegions(
+            partitionIndex, needed - file.headers.size(), file.headers);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+
+    // Headers are only ever added, so a file that lost extents keeps its
+    // surplus header regions with no records.
+    std::vector<char> header(geometry.regionSize);
+    for (std::size_t h = 0; h < file.headers.size(); h++) {
+        std::fill(header.begin(), header.end(), 0);
+        header[0] = EXTENT_REGION;
+        storeU64(header.data() + EXTENT_FILE_SIZE, h == 0 ? file.size : 0);
+        const std::size_t first = h * perHeader;
+        const std::size_t count =
+            first < extents.size()
+                ? std::min<std::size_t>(perHeader, extents.size() - first)
+                : 0;
+        storeU32(header.data() + EXTENT_COUNT, count);
+        for (std::size_t i = 0; i < count; i++) {
+            char *record =
+                header.data() + EXTENT_LIST + i * EXTENT_RECORD_SIZE;
+            storeU32(record, extents[first + i].first);
+            storeU32(record + 4, extents[first + i].second);
+        }
+        geometry.setNext(header.data(), h + 1 < file.headers.size()
+                                            ? file.headers[h + 1]
+                                            : 0);
+        Status status = writeRegion(file.headers[h], header.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    return Status::Ok;
+}
+
+Status Image::freeExtents(const FileRegions &file) {
+    // Extent regions get a type byte again so scans by type see them free.
+    const char deleted = DELETED_REGION;
+    for (const std::vector<uint32_t> *regions : {&file.regions,
+                                                 &file.headers}) {
+        for (uint32_t region : *regions) {
+            Status status = writeAt(geometry.offsetOf(region), &deleted, 1);
+            if (status != Status::Ok) {
+                return status;
+            }
+            int partitionIndex = partitionOf(region);
+            if (partitionIndex >= 0 &&
+                region < allocationHint[partitionIndex]) {
+                allocationHint[partitionIndex] = region;
+            }
+        }
+    }
+    return Status::Ok;
+}
+
+Status Image::walkChain(uint32_t firstRegion, const ChainVisitor &visitor) {
+    const uint32_t maxWindow =
+        std::max<uint32_t>(1, 128 * 1024 / geometry.regionSize);
+    uint32_t window = 1;
+    std::vector<char> buffer;
+    uint32_t currentRegion = firstRegion;
+    uint64_t visited = 0;
+    while (currentRegion != 0) {
+        if (currentRegion >= drive.totalRegions) {
+            return Status::Corrupted;
+        }
+        const uint32_t count = static_cast<uint32_t>(
+            std::min<uint64_t>(window, drive.totalRegions - currentRegion));
+        buffer.resize(count * std::size_t{geometry.regionSize});
+        Status status = readRegions(currentRegion, count, buffer.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+        // Regions of the buffer are used while each next pointer leads to
+        // the region right after.
+        uint32_t used = 0;
+        while (used < count) {
+            if (++visited > drive.totalRegions) {
+                return Status::Corrupted;
+            }
+            const char *regionData =
+                buffer.data() + used * std::size_t{geometry.regionSize};
+            if (visitor(currentRegion, regionData)) {
+                return Status::Ok;
+            }
+            const uint32_t nextRegion = geometry.nextOf(regionData);
+            used++;
+            const bool contiguous = nextRegion == currentRegion + 1;
+            currentRegion = nextRegion;
+            if (!contiguous) {
+                break;
+            }
+        }
+        if (used == count) {
+            window = std::min(window * 2, maxWindow);
+            // The kernel starts on the next window while this one is used.
+            if (!direct && currentRegion != 0 &&
+                currentRegion < drive.totalRegions) {
+                adviseWillNeed(fd, geometry.offsetOf(currentRegion),
+                               window * uint64_t{geometry.regionSize});
+            }
+        } else {
+            window = used;
+        }
+    }
+    return Status::Ok;
+}
+
+Status Image::loadFile(uint32_t firstRegion, FileRegions &file) {
+    file = {};
+    Status result = Status::Ok;
+    Status status = walkChain(firstRegion, [&](uint32_t region,
+                                               const char *regionData) {
+        if (file.regions.empty() && file.headers.empty()) {
+            file.extents = regionData[0] == EXTENT_REGION;
+        }
+        if (regionData[0] != (file.extents ? EXTENT_REGION : FILE_REGION) ||
+            file.regions.size() + file.headers.size() >= drive.totalRegions) {
+            result = Status::Corrupted;
+            return true;
+        }
+        if (!file.extents) {
+            file.regions.push_back(region);
+            return false;
+        }
+
+        if (file.headers.empty()) {
+            file.size = loadU64(regionData + EXTENT_FILE_SIZE);
+        }
+        file.headers.push_back(region);
+        const uint32_t count = loadU32(regionData + EXTENT_COUNT);
+        if (count > geometry.headerExtents) {
+            result = Status::Corrupted;
+            return true;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            const char *record =
+                regionData + EXTENT_LIST + i * EXTENT_RECORD_SIZE;
+            const uint32_t first = loadU32(record);
+            const uint32_t length = loadU32(record + 4);
+            if (length == 0 ||
+                uint64_t{first} + length > drive.totalRegions ||
+                file.regions.size() + length > drive.totalRegions) {
+                result = Status::Corrupted;
+                return true;
+            }
+            for (uint32_t j = 0; j < length; j++) {
+                file.regions.push_back(first + j);
+            }
+        }
+        return false;
+    });
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (result != Status::Ok) {
+        return result;
+    }
+    if (file.extents &&
+        file.size > file.regions.size() * uint64_t{geometry.regionSize}) {
+        return Status::Corrupted;
+    }
+    return Status::Ok;
+}
+
+Status Image::chainOf(uint32_t firstRegion, FileRegions *&file) {
+    {
+        std::lock_guard lock(chainsMutex);
+        auto cached = chains.find(firstRegion);
+        if (cached != chains.end()) {
+            file = &cached->second;
+            return Status::Ok;
+        }
+    }
+
+    FileRegions loaded;
+    Status status = loadFile(firstRegion, loaded);
+    if (status != Status::Ok) {
+        return status;
+    }
+    std::lock_guard lock(chainsMutex);
+    file = &chains.emplace(firstRegion, std::move(loaded)).first->second;
+    return Status::Ok;
+}
+
+Status Image::readFile(const FileRegions &file, uint64_t offset,
+                       uint64_t length, std::vector<char> &data) {
+    // Chain regions start with their type byte; extent regions are all
+    // data.
+    const uint32_t payload =
+        file.extents ? geometry.regionSize : geometry.payload;
+    const uint32_t skip = file.extents ? 0 : 1;
+    const uint64_t fileSize =
+        file.extents ? file.size : file.regions.size() * uint64_t{payload};
+    data.clear();
+    if (offset >= fileSize) {
+        return Status::Ok;
+    }
+    const uint64_t end = offset + std::min(length, fileSize - offset);
+    data.reserve(end - offset);
+
+    // Regions that follow each other on disk are fetched with one read.
+    const std::vector<uint32_t> &regions = file.regions;
+    std::vector<char> run;
+    std::size_t index = offset / payload;
+    const std::size_t lastIndex = (end - 1) / payload;
+    while (index <= lastIndex) {
+        std::size_t span = 1;
+        while (index + span <= lastIndex &&
+               regions[index + span] == regions[index] + span) {
+            span++;
+        }
+        run.resize(span * geometry.regionSize);
+        Status status =
+            readAt(geometry.offsetOf(regions[index]), run.data(), run.size());
+        if (status != Status::Ok) {
+            return status;
+        }
+        for (std::size_t i = 0; i < span; i++) {
+            const uint64_t regionStart = (index + i) * uint64_t{payload};
+            const uint64_t from = std::max(offset, regionStart) - regionStart;
+            const uint64_t to = std::min<uint64_t>(end - regionStart, payload);
+            const char *bytes = run.data() + i * geometry.regionSize + skip;
+            data.insert(data.end(), bytes + from, bytes + to);
+        }
+        index += span;
+    }
+    return Status::Ok;
+}
+
+Status Image::read(int partitionIndex, std::string_view path,
+                   std::vector<char> &data) {
+    DirectoryEntry entry;
+    Status status = resolve(partitionIndex, path, entry);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (entry.isDirectory) {
+        return Status::IsADirectory;
+    }
+
+    // Where the entry records the size, the walk stops there and the
+    // padding of the last region is never returned.
+    const bool sized = entryTrailer == SIZED_ENTRY_TRAILER_SIZE;
+    data.clear();
+    bool extents = false;
+    Status result = Status::Ok;
+    status = walkChain(entry.region, [&](uint32_t, const char *regionData) {
+        if (data.empty() && regionData[0] == EXTENT_REGION) {
+            extents = true;
+            return true;
+        }
+        if (regionData[0] != FILE_REGION) {
+            result = Status::Corrupted;
+            return true;
+        }
+        data.insert(data.end(), regionData + 1, regionData + geometry.next);
+        return sized && data.size() >= entry.size;
+    });
+    if (status == Status::Ok) {
+        status = result;
+    }
+    if (sized && data.size() > entry.size) {
+        data.resize(entry.size);
+    }
+    if (status != Status::Ok || !extents) {
+        return status;
+    }
+    FileRegions file;
+    status = loadFile(entry.region, file);
+    return status == Status::Ok ? readFile(file, 0, file.size, data) : status;
+}
+
+Status Image::readRange(int partitionIndex, std::string_view path,
+                        uint64_t offset, uint64_t length,
+                        std::vector<char> &data) {
+    DirectoryEntry entry;
+    Status status = resolve(partitionIndex, path, entry);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (entry.isDirectory) {
+        return Status::IsADirectory;
+    }
+    if (entryTrailer == SIZED_ENTRY_TRAILER_SIZE) {
+        length = offset < entry.size ? std::min(length, entry.size - offset)
+                                     : 0;
+    }
+    FileRegions *file = nullptr;
+    status = chainOf(entry.region, file);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return readFile(*file, offset, length, data);
+}
+
+Status Image::write(int partitionIndex, std::string_view path,
+                    const char *data, std::size_t size, FileLayout layout) {
+    if (layout == FileLayout::Extents && !freeBitmap) {
+        return Status::InvalidArgument;
+    }
+    Transaction transaction(*this);
+    uint32_t parentRegion = 0;
+    std::string_view name;
+    Status status = resolveParent(partitionIndex, path, parentRegion, name);
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    FileRegions file;
+    if (layout == FileLayout::Extents) {
+        file.extents = true;
+        file.size = size;
+        status = writeExtents(partitionIndex, data, size, file);
+        if (status == Status::Ok) {
+            status = storeExtents(partitionIndex, file);
+        }
+    } else {
+        status = allocateRegions(partitionIndex, geometry.regionsFor(size),
+                                 file.regions);
+        if (status == Status::Ok) {
+            status = writeChain(file.regions, data, size);
+        }
+    }
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    // The entry of an extent file points at its first header.
+    const uint32_t firstRegion =
+        file.extents ? file.headers[0] : file.regions[0];
+    uint64_t currentTime = getTime();
+    DirectoryEntry entry{name,        currentTime, currentTime,
+                         currentTime, firstRegion, false, size};
+    status = insertEntry(partitionIndex, parentRegion, entry);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return transaction.commit();
+}
+
+Status Image::contentLength(const FileRegions &file, uint64_t &length) {
+    if (file.extents) {
+        length = file.size;
+        return Status::Ok;
+    }
+    const std::vector<uint32_t> &chain = file.regions;
+    std::vector<char> regionData(geometry.regionSize);
+    Status status = readRegion(chain.back(), regionData.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    uint32_t used = geometry.payload;
+    while (used > 0 && regionData[used] == 0) {
+        used--;
+    }
+    length = (chain.size() - 1) * uint64_t{geometry.payload} + used;
+    return Status::Ok;
+}
+
+Status Image::touchEntry(const EntryLocation &location,
+                         uint64_t lastModified) {
+    if (location.region == 0) {
+        return Status::Ok;
+    }
+    char timestamp[8];
+    storeU64(timestamp, lastModified);
+    return writeAt(geometry.offsetOf(location.region) + location.offset +
+                       EntryLastModified::offset,
+                   timestamp, sizeof(timestamp));
+}
+
+Status Image::storeEntrySize(const EntryLocation &location,
+                             std::size_t nameLength, uint64_t size) {
+    if (location.region == 0 || entryTrailer != SIZED_ENTRY_TRAILER_SIZE) {
+        return Status::Ok;
+    }
+    char bytes[8];
+    storeU64(bytes, size);
+    return writeAt(geometry.offsetOf(location.region) + location.offset +
+                       entrySize(nameLength, 0) + TrailerSize::offset,
+                   bytes, sizeof(bytes));
+}
+
+Status Image::touch(int partitionIndex, std::string_view path,
+                     uint64_t lastModified) {
+    Transaction transaction(*this);
+    DirectoryEntry entry;
+    EntryLocation location;
+    Status status = resolve(partitionIndex, path, entry, &location);
+    if (status != Status::Ok) {
+        return status;
+    }
+    status = touchEntry(location, lastModified);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return transaction.commit();
+}
+
+Status Image::writeRange(int partitionIndex, std::string_view path,
+                         uint64_t offset, const char *data, std::size_t size) {
+    Transaction transaction(*this);
+    DirectoryEntry entry;
+    EntryLocation location;
+    Status status = resolve(partitionIndex, path, entry, &location);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (entry.isDirectory) {
+        return Status::IsADirectory;
+    }
+    if (size == 0) {
+        return Status::Ok;
+    }
+    FileRegions *file = nullptr;
+    status = chainOf(entry.region, file);
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    const uint32_t payload =
+        file->extents ? geometry.regionSize : geometry.payload;
+    const uint32_t skip = file->extents ? 0 : 1;
+    std::vector<uint32_t> &regions = file->regions;
+    const uint64_t end = offset + size;
+    const std::size_t firstIndex = offset / payload;
+    const std::size_t lastIndex = (end - 1) / payload;
+    const std::size_t existing = regions.size();
+
+    // New regions are written before anything points at them, so the file
+    // never references a half written region: a chain links them to each
+    // other before its old tail, an extent file reserves them before its
+    // headers list them.
+    if (lastIndex >= existing) {
+        const uint64_t extraStart = existing * uint64_t{payload};
+        std::vector<char> contents(
+            (lastIndex + 1 - existing) * std::size_t{payload}, 0);
+        const uint64_t copyFrom = std::max(offset, extraStart);
+        std::memcpy(contents.data() + (copyFrom - extraStart),
+                    data + (copyFrom - offset), end - copyFrom);
+        if (file->extents) {
+            status = writeExtents(partitionIndex, contents.data(),
+                                  contents.size(), *file);
+        } else {
+            std::vector<uint32_t> extra;
+            status = allocateRegions(partitionIndex, lastIndex + 1 - existing,
+                                     extra);
+            if (status == Status::Ok) {
+                status = writeChain(extra, contents.data(), contents.size());
+            }
+            std::vector<char> tail(geometry.regionSize);
+            if (status == Status::Ok) {
+                status = readRegion(regions.back(), tail.data());
+            }
+            if (status == Status::Ok) {
+                geometry.setNext(tail.data(), extra.front());
+                status = writeRegion(regions.back(), tail.data());
+            }
+            regions.insert(regions.end(), extra.begin(), extra.end());
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+
+    // Existing regions touched by the range are patched a run of
+    // consecutive regions at a time.
+    std::vector<char> run;
+    std::size_t index = firstIndex;
+    const std::size_t lastExisting =
+        existing == 0 ? 0 : std::min(lastIndex, existing - 1);
+    while (existing > 0 && index <= lastExisting) {
+        std::size_t span = 1;
+        while (index + span <= lastExisting &&
+               regions[index + span] == regions[index] + span) {
+            span++;
+        }
+        const uint64_t runOffset = geometry.offsetOf(regions[index]);
+        run.resize(span * geometry.regionSize);
+        status = readAt(runOffset, run.data(), run.size());
+        if (status != Status::Ok) {
+            return status;
+        }
+        for (std::size_t i = 0; i < span; i++) {
+            const uint64_t regionStart = (index + i) * uint64_t{payload};
+            const uint64_t from = std::max(offset, regionStart);
+            const uint64_t to = std::min<uint64_t>(end, regionStart + payload);
+            std::memcpy(run.data() + i * geometry.regionSize + skip +
+                            (from - regionStart),
+                        data + (from - offset), to - from);
+        }
+        status = file->extents
+                     ? writeData(runOffset, run.data(), run.size())
+                     : writeAt(runOffset, run.data(), run.size());
+        if (status != Status::Ok) {
+            return status;
+        }
+        index += span;
+    }
+
+    if (file->extents) {
+        file->size = std::max(file->size, end);
+        status = storeExtents(partitionIndex, *file);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    if (end > entry.size) {
+        status = storeEntrySize(location, entry.name.size(), end);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    status = touchEntry(location, getTime());
+    if (status != Status::Ok) {
+        return status;
+    }
+    return transaction.commit();
+}
+
+Status Image::append(int partitionIndex, std::string_view path,
+                     const char *data, std::size_t size) {
+    DirectoryEntry entry;
+    Status status = resolve(partitionIndex, path, entry);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (entry.isDirectory) {
+        return Status::IsADirectory;
+    }
+    if (entryTrailer == SIZED_ENTRY_TRAILER_SIZE) {
+        return writeRange(partitionIndex, path, entry.size, data, size);
+    }
+    FileRegions *file = nullptr;
+    status = chainOf(entry.region, file);
+    if (status != Status::Ok) {
+        return status;
+    }
+    uint64_t length = 0;
+    status = contentLength(*file, length);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return writeRange(partitionIndex, path, length, data, size);
+}
+
+Status Image::remove(int partitionIndex, std::string_view path) {
+    Transaction transaction(*this);
+    DirectoryEntry entry;
+    EntryLocation location;
+    Status status = resolve(partitionIndex, path, entry, &location);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (entry.isDirectory) {
+        return Status::IsADirectory;
+    }
+
+    status = eraseEntry(location);
+    if (status != Status::Ok) {
+        return status;
+    }
+    status = freeChain(entry.region);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return transaction.commit();
+}
+
+} // namespace ionicfs
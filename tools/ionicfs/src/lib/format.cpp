@@ -0,0 +1,149 @@
+#include "io.hpp"
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ionicfs {
+
+Status format(const fs::path &diskPath,
+              const std::vector<Partition> &partitions,
+              const std::function<void(const Partition &, int)> &progress,
+              bool direct, uint32_t regionSize) {
+    std::uintmax_t size = 0;
+    Status status = diskSize(diskPath, size);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (partitions.empty() || partitions.size() > PARTITION_COUNT ||
+        !validRegionSize(regionSize) || size < regionSize) {
+        return Status::InvalidArgument;
+    }
+    const Geometry geometry = geometryFor(regionSize);
+    const uint64_t totalRegions = size / regionSize;
+    for (const Partition &partition : partitions) {
+        if (partition.usable &&
+            (partition.partitionRegion < geometry.prefaceRegions() ||
+             partition.partitionSize <=
+                 geometry.bitmapRegionsFor(partition.partitionSize) ||
+             static_cast<uint64_t>(partition.partitionRegion) +
+                     partition.partitionSize >
+                 totalRegions)) {
+            return Status::InvalidArgument;
+        }
+    }
+
+    if (direct && size % DIRECT_ALIGNMENT != 0) {
+        return Status::InvalidArgument;
+    }
+    int fd = openDisk(diskPath, O_RDWR, direct);
+    if (fd < 0) {
+        return Status::IoError;
+    }
+    status = lockFile(fd, true, std::chrono::milliseconds(-1));
+    if (status != Status::Ok) {
+        ::close(fd);
+        return status;
+    }
+    auto writeDisk = [&](uint64_t offset, const char *buffer,
+                         std::size_t length) {
+        return direct ? writeDirect(fd, offset, buffer, length)
+                      : writeFully(fd, offset, buffer, length);
+    };
+
+    // The region size is recorded right after the preface.
+    char preface[PREFACE_SIZE + 4] = {0};
+    for (std::size_t i = 0; i < partitions.size(); i++) {
+        const Partition &partition = partitions[i];
+        if (!partition.usable) {
+            continue;
+        }
+        char *entry = preface + partitionEntryOffset(i);
+        std::memcpy(entry, partition.name, sizeof(partition.name));
+        PartitionStart::store(entry, partition.partitionRegion);
+        PartitionSize::store(entry, partition.partitionSize);
+    }
+    std::memcpy(preface + SANITY_OFFSET, "IONFS" IONICFS_VERSION, 8);
+    PrefaceRegionSize::store(preface, regionSize);
+    status = writeDisk(0, preface, sizeof(preface));
+    if (status != Status::Ok) {
+        ::close(fd);
+        return status;
+    }
+
+    const uint32_t chunkRegions =
+        std::max<uint32_t>(1, 128 * 1024 / regionSize);
+    std::vector<char> zeroes(chunkRegions * regionSize, 0);
+    for (const Partition &partition : partitions) {
+        if (!partition.usable) {
+            continue;
+        }
+
+        uint32_t cleared = 0;
+        while (cleared < partition.partitionSize) {
+            uint32_t span =
+                std::min(chunkRegions, partition.partitionSize - cleared);
+            uint64_t offset =
+                geometry.offsetOf(partition.partitionRegion + cleared);
+            status = writeDisk(offset, zeroes.data(), span * regionSize);
+            if (status != Status::Ok) {
+                ::close(fd);
+                return status;
+            }
+            cleared += span;
+            if (progress) {
+                progress(partition,
+                         static_cast<int>(100ull * cleared /
+                                          partition.partitionSize));
+            }
+        }
+
+        // The root directory only holds its "." entry, which records no
+        // size, and the index marker.
+        std::vector<char> root(regionSize, 0);
+        uint64_t currentTime = getTime();
+        char *self = root.data() + 1;
+        root[0] = DIRECTORY_REGION;
+        self[0] = DIRECTORY_REGION;
+        EntryLastAccessed::store(self, currentTime);
+        EntryLastModified::store(self, currentTime);
+        EntryCreated::store(self, currentTime);
+        std::memcpy(self + ENTRY_HEADER_SIZE, ".", 2);
+        TrailerRegion::store(self + ENTRY_HEADER_SIZE + 2,
+                             partition.partitionRegion);
+        root[1 + entrySize(1, SIZED_ENTRY_TRAILER_SIZE)] = DELETED_REGION;
+        status = writeDisk(geometry.offsetOf(partition.partitionRegion),
+                           root.data(), root.size());
+        if (status != Status::Ok) {
+            ::close(fd);
+            return status;
+        }
+
+        // The bitmap follows the root and marks both as used.
+        const uint32_t bitmapRegions =
+            geometry.bitmapRegionsFor(partition.partitionSize);
+        std::vector<char> bitmap(bitmapRegions * regionSize, 0);
+        for (uint32_t i = 0; i < bitmapRegions; i++) {
+            bitmap[i * regionSize] = BITMAP_REGION;
+        }
+        for (uint32_t bit = 0; bit <= bitmapRegions; bit++) {
+            bitmap[bit / geometry.bitmapBits * regionSize + 1 +
+                   bit % geometry.bitmapBits / 8] |=
+                static_cast<char>(1u << (bit % 8));
+        }
+        status = writeDisk(geometry.offsetOf(partition.partitionRegion + 1),
+                           bitmap.data(), bitmap.size());
+        if (status != Status::Ok) {
+            ::close(fd);
+            return status;
+        }
+    }
+
+    ::close(fd);
+    return Status::Ok;
+}
+
+} // namespace ionicfs
@@ -0,0 +1,130 @@
+#include "hash.hpp"
+#include <cstring>
+
+namespace ionicfs {
+
+namespace {
+
+constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t read64(const unsigned char *data) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+inline uint32_t read32(const unsigned char *data) {
+    return static_cast<uint32_t>(data[0]) |
+           (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) |
+           (static_cast<uint32_t>(data[3]) << 24);
+}
+
+inline uint64_t mixRound(uint64_t accumulator, uint64_t input) {
+    accumulator += input * PRIME2;
+    return rotateLeft(accumulator, 31) * PRIME1;
+}
+
+inline uint64_t mergeRound(uint64_t accumulator, uint64_t value) {
+    accumulator ^= mixRound(0, value);
+    return accumulator * PRIME1 + PRIME4;
+}
+
+} // namespace
+
+ContentHash::ContentHash(uint64_t seed)
+    : accumulators{seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1},
+      seed(seed) {}
+
+void ContentHash::update(const void *data, std::size_t size) {
+    const auto *input = static_cast<const unsigned char *>(data);
+    totalLength += size;
+
+    if (buffered + size < sizeof(buffer)) {
+        std::memcpy(buffer + buffered, input, size);
+        buffered += size;
+        return;
+    }
+    if (buffered > 0) {
+        std::size_t fill = sizeof(buffer) - buffered;
+        std::memcpy(buffer + buffered, input, fill);
+        for (int i = 0; i < 4; i++) {
+            accumulators[i] =
+                mixRound(accumulators[i], read64(buffer + i * 8));
+        }
+        input += fill;
+        size -= fill;
+        buffered = 0;
+    }
+    while (size >= sizeof(buffer)) {
+        for (int i = 0; i < 4; i++) {
+            accumulators[i] =
+                mixRound(accumulators[i], read64(input + i * 8));
+        }
+        input += sizeof(buffer);
+        size -= sizeof(buffer);
+    }
+    std::memcpy(buffer, input, size);
+    buffered = size;
+}
+
+uint64_t ContentHash::digest() const {
+    uint64_t hash;
+    if (totalLength >= sizeof(buffer)) {
+        hash = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7) +
+               rotateLeft(accumulators[2], 12) +
+               rotateLeft(accumulators[3], 18);
+        for (uint64_t accumulator : accumulators) {
+            hash = mergeRound(hash, accumulator);
+        }
+    } else {
+        hash = seed + PRIME5;
+    }
+    hash += totalLength;
+
+    const unsigned char *tail = buffer;
+    std::size_t remaining = buffered;
+    while (remaining >= 8) {
+        hash ^= mixRound(0, read64(tail));
+        hash = rotateLeft(hash, 27) * PRIME1 + PRIME4;
+        tail += 8;
+        remaining -= 8;
+    }
+    if (remaining >= 4) {
+        hash ^= static_cast<uint64_t>(read32(tail)) * PRIME1;
+        hash = rotateLeft(hash, 23) * PRIME2 + PRIME3;
+        tail += 4;
+        remaining -= 4;
+    }
+    while (remaining > 0) {
+        hash ^= *tail * PRIME5;
+        hash = rotateLeft(hash, 11) * PRIME1;
+        tail++;
+        remaining--;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t contentHash(const void *data, std::size_t size) {
+    ContentHash hash;
+    hash.update(data, size);
+    return hash.digest();
+}
+
+} // namespace ionicfs
@@ -0,0 +1,408 @@
+#include "io.hpp"
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include "overlay.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ionicfs {
+
+const char *statusMessage(Status status) {
+    switch (status) {
+    case Status::Ok:
+        return "Success";
+    case Status::ImageNotFound:
+        return "Disk path does not exist";
+    case Status::InvalidImage:
+        return "Disk is not an IonicFS image";
+    case Status::IoError:
+        return "Unable to access disk file";
+    case Status::ReadOnly:
+        return "Disk was opened read-only";
+    case Status::InvalidPartition:
+        return "Invalid partition index";
+    case Status::PartitionUnusable:
+        return "Partition is not usable";
+    case Status::NotFound:
+        return "No such file or directory";
+    case Status::NotADirectory:
+        return "Not a directory";
+    case Status::IsADirectory:
+        return "Is a directory";
+    case Status::AlreadyExists:
+        return "Entry already exists";
+    case Status::InvalidName:
+        return "Invalid entry name";
+    case Status::InvalidArgument:
+        return "Invalid argument";
+    case Status::NoSpace:
+        return "No free region found";
+    case Status::Corrupted:
+        return "Disk structures are corrupted";
+    case Status::Locked:
+        return "Disk is locked by another process";
+    case Status::Aborted:
+        return "Transaction was rolled back";
+    }
+    return "Unknown error";
+}
+
+uint64_t getTime() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+Status diskSize(const fs::path &diskPath, std::uintmax_t &size) {
+    std::error_code error;
+    if (!fs::exists(diskPath, error)) {
+        return Status::ImageNotFound;
+    }
+    if (fs::is_directory(diskPath, error)) {
+        return Status::InvalidImage;
+    }
+    if (fs::is_block_file(diskPath, error)) {
+        Status status = blockDeviceSize(diskPath, size);
+        if (status != Status::Ok) {
+            return status;
+        }
+    } else {
+        size = fs::file_size(diskPath, error);
+        if (error) {
+            return Status::IoError;
+        }
+    }
+    return size < PREFACE_SIZE ? Status::InvalidImage : Status::Ok;
+}
+
+Image::Image() = default;
+
+Image::~Image() { close(); }
+
+Status Image::open(const fs::path &diskPath, bool writable,
+                   const OpenOptions &options) {
+    close();
+    std::uintmax_t size = 0;
+    Status status = diskSize(diskPath, size);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (options.direct && size % DIRECT_ALIGNMENT != 0) {
+        return Status::InvalidArgument;
+    }
+
+    const bool layered = !options.overlayPath.empty();
+    int descriptor = openDisk(
+        diskPath, writable && !layered ? O_RDWR : O_RDONLY, options.direct);
+    if (descriptor < 0) {
+        return Status::IoError;
+    }
+    fd = descriptor;
+    status = lockFile(fd, writable && !layered, options.lockTimeout);
+    if (status != Status::Ok) {
+        close();
+        return status;
+    }
+    this->writable = writable;
+    direct = options.direct;
+    drive.diskSize = size;
+    status = loadRegionSize();
+    if (status != Status::Ok) {
+        close();
+        return status;
+    }
+    drive.totalRegions = size / geometry.regionSize;
+    zeroedFrom = drive.totalRegions;
+
+    if (layered) {
+        overlay = std::make_unique<Overlay>();
+        status = overlay->open(options.overlayPath, size / OVERLAY_BLOCK_SIZE,
+                               writable, options.lockTimeout);
+        if (status != Status::Ok) {
+            close();
+            return status;
+        }
+    }
+    status = loadPreface();
+    if (status != Status::Ok) {
+        close();
+    }
+    return status;
+}
+
+void Image::close() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    writable = false;
+    direct = false;
+    overlay.reset();
+    for (std::vector<uint32_t> &bitmap : bitmapChains) {
+        bitmap.clear();
+    }
+    transactionDepth = 0;
+    discardPending();
+}
+
+Status Image::readLayers(uint64_t offset, char *buffer, std::size_t size) {
+    if (!overlay) {
+        return diskRead(offset, buffer, size);
+    }
+    while (size > 0) {
+        const uint32_t block = offset / OVERLAY_BLOCK_SIZE;
+        const uint32_t within = offset % OVERLAY_BLOCK_SIZE;
+        std::size_t span =
+            std::min<std::size_t>(size, OVERLAY_BLOCK_SIZE - within);
+        Status status;
+        if (overlay->contains(block)) {
+            status = overlay->read(block, within, buffer, span);
+        } else {
+            // Runs of blocks the overlay does not hold come from the disk
+            // in a single read.
+            while (span < size &&
+                   !overlay->contains((offset + span) / OVERLAY_BLOCK_SIZE)) {
+                span += std::min<std::size_t>(size - span, OVERLAY_BLOCK_SIZE);
+            }
+            status = diskRead(offset, buffer, span);
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+        buffer += span;
+        offset += span;
+        size -= span;
+    }
+    return Status::Ok;
+}
+
+Status Image::writeLayers(uint64_t offset, const char *buffer,
+                          std::size_t size) {
+    if (!overlay) {
+        return diskWrite(offset, buffer, size);
+    }
+    while (size > 0) {
+        const uint32_t block = offset / OVERLAY_BLOCK_SIZE;
+        const uint32_t within = offset % OVERLAY_BLOCK_SIZE;
+        const std::size_t span =
+            std::min<std::size_t>(size, OVERLAY_BLOCK_SIZE - within);
+        Status status;
+        if (overlay->contains(block)) {
+            status = overlay->write(block, within, buffer, span);
+        } else {
+            // First write to the block: copy it from the disk, then patch.
+            char copy[OVERLAY_BLOCK_SIZE];
+            status = span == OVERLAY_BLOCK_SIZE
+                         ? Status::Ok
+                         : diskRead(static_cast<uint64_t>(block) *
+                                        OVERLAY_BLOCK_SIZE,
+                                    copy, OVERLAY_BLOCK_SIZE);
+            if (status == Status::Ok) {
+                std::memcpy(copy + within, buffer, span);
+                status = overlay->add(block, copy);
+            }
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+        buffer += span;
+        offset += span;
+        size -= span;
+    }
+    return Status::Ok;
+}
+
+Status Image::diskRead(uint64_t offset, char *buffer, std::size_t size) {
+    return direct ? readDirect(fd, offset, buffer, size)
+                  : readFully(fd, offset, buffer, size);
+}
+
+Status Image::diskWrite(uint64_t offset, const char *buffer,
+                        std::size_t size) {
+    return direct ? writeDirect(fd, offset, buffer, size)
+                  : writeFully(fd, offset, buffer, size);
+}
+
+Status Image::readRegion(uint32_t region, char *buffer) {
+    if (region >= drive.totalRegions) {
+        return Status::Corrupted;
+    }
+    return readAt(geometry.offsetOf(region), buffer, geometry.regionSize);
+}
+
+Status Image::readRegions(uint32_t firstRegion, uint32_t count,
+                          char *buffer) {
+    if (static_cast<uint64_t>(firstRegion) + count > drive.totalRegions) {
+        return Status::Corrupted;
+    }
+    return readAt(geometry.offsetOf(firstRegion), buffer,
+                  static_cast<std::size_t>(count) * geometry.regionSize);
+}
+
+Status Image::writeRegion(uint32_t region, const char *buffer) {
+    if (region >= drive.totalRegions) {
+        return Status::Corrupted;
+    }
+    Transaction transaction(*this);
+    Status status =
+        writeAt(geometry.offsetOf(region), buffer, geometry.regionSize);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return transaction.commit();
+}
+
+Status Image::loadRegionSize() {
+    char preface[PREFACE_SIZE + 4];
+    Status status = diskRead(0, preface, PREFACE_SIZE);
+    if (status != Status::Ok) {
+        return status;
+    }
+    uint32_t regionSize = DEFAULT_REGION_SIZE;
+    if (std::memcmp(preface + SANITY_OFFSET, "IONFS", 5) == 0 &&
+        std::memcmp(preface + SANITY_OFFSET + 5, "004", 3) >= 0) {
+        status = diskRead(REGION_SIZE_OFFSET, preface + PREFACE_SIZE, 4);
+        if (status != Status::Ok) {
+            return status;
+        }
+        regionSize = PrefaceRegionSize::load(preface);
+    }
+    if (!validRegionSize(regionSize) || drive.diskSize < regionSize) {
+        return Status::InvalidImage;
+    }
+    drive.regionSize = regionSize;
+    geometry = geometryFor(regionSize);
+    return Status::Ok;
+}
+
+Status Image::loadPreface() {
+    char preface[PREFACE_SIZE];
+    Status status = readAt(0, preface, sizeof(preface));
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (std::memcmp(preface + SANITY_OFFSET, "IONFS", 5) != 0) {
+        return Status::InvalidImage;
+    }
+
+    std::memcpy(drive.bootCode, preface, BOOT_CODE_SIZE);
+    for (uint32_t i = 0; i < PARTITION_COUNT; i++) {
+        const char *entry = preface + partitionEntryOffset(i);
+        Partition &partition = drive.partitions[i];
+        std::memcpy(partition.name, entry, sizeof(partition.name));
+        partition.partitionRegion = PartitionStart::load(entry);
+        partition.partitionSize = PartitionSize::load(entry);
+        partition.usable = partition.partitionSize > 0;
+    }
+    std::memcpy(drive.version, preface + SANITY_OFFSET, 8);
+    drive.version[8] = '\0';
+    freeBitmap = std::strcmp(drive.version + 5, "003") >= 0;
+    entryTrailer = std::strcmp(drive.version + 5, "005") >= 0
+                       ? SIZED_ENTRY_TRAILER_SIZE
+                       : ENTRY_TRAILER_SIZE;
+    return Status::Ok;
+}
+
+Status Image::partitionAt(int partitionIndex, const Partition *&partition) {
+    if (partitionIndex < 0 ||
+        static_cast<uint32_t>(partitionIndex) >= PARTITION_COUNT) {
+        return Status::InvalidPartition;
+    }
+    partition = &drive.partitions[partitionIndex];
+    if (!partition->usable) {
+        return Status::PartitionUnusable;
+    }
+    return Status::Ok;
+}
+
+int Image::partitionOf(uint32_t region) const {
+    for (uint32_t i = 0; i < PARTITION_COUNT; i++) {
+        const Partition &partition = drive.partitions[i];
+        if (partition.usable && region >= partition.partitionRegion &&
+            region - partition.partitionRegion < partition.partitionSize) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+Status Image::setBootCode(const char *data, std::size_t size) {
+    if (size == 0 || size > BOOT_CODE_SIZE) {
+        return Status::InvalidArgument;
+    }
+    Transaction transaction(*this);
+    Status status = writeAt(0, data, size);
+    if (status == Status::Ok) {
+        status = transaction.commit();
+    }
+    if (status == Status::Ok) {
+        std::memcpy(drive.bootCode, data, size);
+    }
+    return status;
+}
+
+Status Image::allocateRegions(int partitionIndex, uint32_t count,
+                              std::vector<uint32_t> &regions) {
+    const Partition *partition = nullptr;
+    Status status = partitionAt(partitionIndex, partition);
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    const uint32_t start = partition->partitionRegion;
+    const uint32_t end = start + partition->partitionSize;
+    uint32_t hint = allocationHint[partitionIndex];
+    if (hint <= start || hint >= end) {
+        hint = start + 1;
+    }
+    const std::size_t first = regions.size();
+    if (freeBitmap) {
+        status = allocateFromBitmap(partitionIndex, hint, count, regions);
+        markFresh(regions, first);
+        return status;
+    }
+
+    // Without a bitmap, type bytes are scanned 64 KiB of regions at a
+    // time, starting where the previous allocation stopped and wrapping
+    // around once.
+    const uint32_t batchRegions =
+        std::max<uint32_t>(1, 65536 / geometry.regionSize);
+    std::vector<char> batch(batchRegions * geometry.regionSize);
+
+    uint32_t region = hint;
+    uint32_t scanned = 0;
+    while (regions.size() - first < count && scanned < end - start) {
+        if (region >= end) {
+            region = start;
+        }
+        uint32_t span = std::min({batchRegions, end - region,
+                                  partition->partitionSize - scanned});
+        status = readRegions(region, span, batch.data());
+        if (status != Status::Ok) {
+            regions.resize(first);
+            return status;
+        }
+        for (uint32_t i = 0; i < span && regions.size() - first < count; i++) {
+            char type = batch[i * geometry.regionSize];
+            if (type == EMPTY_REGION || type == DELETED_REGION) {
+                regions.push_back(region + i);
+            }
+        }
+        region += span;
+        scanned += span;
+    }
+
+    if (regions.size() - first < count) {
+        regions.resize(first);
+        return Status::NoSpace;
+    }
+    allocationHint[partitionIndex] = regions.back() + 1;
+    markFresh(regions, first);
+    return Status::Ok;
+}
+
+} // namespace ionicfs
@@ -0,0 +1,357 @@
+#include "hash.hpp"
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace ionicfs {
+
+namespace {
+
+uint32_t nameHash(std::string_view name) {
+    return static_cast<uint32_t>(contentHash(name.data(), name.size()));
+}
+
+// Offset of the index marker in the first region of a directory, or 0 when
+// the directory has none.
+uint32_t findMarker(const char *regionData, uint32_t next, uint32_t trailer) {
+    uint32_t offset = 1;
+    while (offset + ENTRY_HEADER_SIZE <= next &&
+           regionData[offset] != EMPTY_REGION) {
+        uint32_t length = entryLength(regionData, offset, next, trailer);
+        if (length == 0) {
+            return 0;
+        }
+        if (regionData[offset] == DELETED_REGION &&
+            length == entrySize(0, trailer)) {
+            return offset;
+        }
+        offset += length;
+    }
+    return 0;
+}
+
+uint32_t markerRegion(uint32_t markerOffset) {
+    return markerOffset + ENTRY_HEADER_SIZE + 1;
+}
+
+} // namespace
+
+Status Image::loadIndex(uint32_t directoryRegion, char *firstRegion,
+                        DirectoryIndex &index) {
+    index = {};
+    Status status = readRegion(directoryRegion, firstRegion);
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (firstRegion[0] != DIRECTORY_REGION) {
+        return Status::NotADirectory;
+    }
+    index.markerOffset =
+        findMarker(firstRegion, geometry.next, entryTrailer);
+    if (index.markerOffset == 0) {
+        return Status::Ok;
+    }
+    index.header = loadU32(firstRegion + markerRegion(index.markerOffset));
+    if (index.header == 0) {
+        return Status::Ok;
+    }
+
+    std::vector<char> header(geometry.regionSize);
+    status = readRegion(index.header, header.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    index.bucketCount = loadU32(header.data() + INDEX_BUCKET_COUNT);
+    index.tail = loadU32(header.data() + INDEX_TAIL);
+    const uint32_t tableCount =
+        (index.bucketCount + geometry.tableBuckets - 1) / geometry.tableBuckets;
+    if (header[0] != INDEX_REGION || index.bucketCount == 0 ||
+        tableCount > geometry.maxTables) {
+        return Status::Corrupted;
+    }
+    for (uint32_t i = 0; i < tableCount; i++) {
+        index.tables.push_back(loadU32(header.data() + INDEX_TABLES + i * 4));
+    }
+    return Status::Ok;
+}
+
+Status Image::lookupIndex(uint32_t directoryRegion,
+                          const DirectoryIndex &index, std::string_view name,
+                          DirectoryEntry &entry, EntryLocation &location) {
+    // Header, table and bucket lead to the directory regions holding
+    // entries with the same hash; only those are read.
+    const uint32_t hash = nameHash(name);
+    const uint32_t bucket = hash % index.bucketCount;
+    std::vector<char> table(geometry.regionSize);
+    Status status =
+        readRegion(index.tables[bucket / geometry.tableBuckets], table.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (table[0] != INDEX_REGION) {
+        return Status::Corrupted;
+    }
+    const uint32_t bucketRegion =
+        loadU32(table.data() + 1 + bucket % geometry.tableBuckets * 4);
+    if (bucketRegion == 0) {
+        return Status::NotFound;
+    }
+    std::vector<char> slots(geometry.regionSize);
+    status = readRegion(bucketRegion, slots.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    if (slots[0] != INDEX_REGION) {
+        return Status::Corrupted;
+    }
+
+    std::vector<char> regionData(geometry.regionSize);
+    for (uint32_t i = 0; i < geometry.bucketSlots; i++) {
+        const char *slot = slots.data() + 1 + i * INDEX_SLOT_SIZE;
+        const uint32_t region = loadU32(slot + 4);
+        if (region == 0 || loadU32(slot) != hash) {
+            continue;
+        }
+        status = readRegion(region, regionData.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+        bool found = false;
+        status = forEachInRegion(
+            directoryRegion, region, regionData.data(),
+            [&](const DirectoryEntry &candidate, const EntryLocation &where) {
+                if (candidate.name != name) {
+                    return false;
+                }
+                entry = candidate;
+                entry.name = name;
+                location = where;
+                found = true;
+                return true;
+            },
+            found);
+        if (status != Status::Ok || found) {
+            return status;
+        }
+    }
+    return Status::NotFound;
+}
+
+Status Image::buildIndex(uint32_t directoryRegion, uint32_t tail,
+                         uint32_t bucketCount, DirectoryIndex &index) {
+    struct Slot {
+        uint32_t hash;
+        uint32_t region;
+    };
+    std::vector<Slot> entries;
+    Status status = forEachEntry(
+        directoryRegion,
+        [&](const DirectoryEntry &entry, const EntryLocation &where) {
+            entries.push_back({nameHash(entry.name), where.region});
+            return false;
+        });
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    // The bucket count doubles until every bucket fits in one region, so
+    // lookups never follow a chain of buckets.
+    const uint32_t maxBuckets = geometry.maxTables * geometry.tableBuckets;
+    bucketCount = std::min(bucketCount, maxBuckets);
+    std::vector<std::vector<Slot>> buckets;
+    bool fits = false;
+    while (!fits) {
+        buckets.assign(bucketCount, {});
+        fits = true;
+        for (const Slot &slot : entries) {
+            auto &bucket = buckets[slot.hash % bucketCount];
+            bucket.push_back(slot);
+            fits = fits && bucket.size() <= geometry.bucketSlots;
+        }
+        if (!fits && bucketCount == maxBuckets) {
+            break;
+        }
+        if (!fits) {
+            bucketCount = std::min(bucketCount * 2, maxBuckets);
+        }
+    }
+
+    if (index.header != 0) {
+        status = freeIndex(index);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    index.header = 0;
+    index.tables.clear();
+    char marker[4] = {0};
+    const uint64_t markerAt =
+        geometry.offsetOf(directoryRegion) + markerRegion(index.markerOffset);
+    if (!fits) {
+        // Too many colliding names: lookups fall back to walking the chain.
+        return writeAt(markerAt, marker, sizeof(marker));
+    }
+
+    const uint32_t tableCount =
+        (bucketCount + geometry.tableBuckets - 1) / geometry.tableBuckets;
+    uint32_t used = 0;
+    for (const auto &bucket : buckets) {
+        used += bucket.empty() ? 0 : 1;
+    }
+    std::vector<uint32_t> regions;
+    status = allocateRegions(partitionOf(directoryRegion),
+                             1 + tableCount + used, regions);
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    std::vector<char> header(geometry.regionSize);
+    header[0] = INDEX_REGION;
+    storeU32(header.data() + INDEX_BUCKET_COUNT, bucketCount);
+    storeU32(header.data() + INDEX_TAIL, tail);
+    std::size_t next = 1 + tableCount;
+    for (uint32_t t = 0; t < tableCount; t++) {
+        std::vector<char> table(geometry.regionSize);
+        table[0] = INDEX_REGION;
+        for (uint32_t i = 0; i < geometry.tableBuckets; i++) {
+            const uint32_t b = t * geometry.tableBuckets + i;
+            if (b >= bucketCount || buckets[b].empty()) {
+                continue;
+            }
+            std::vector<char> slots(geometry.regionSize);
+            slots[0] = INDEX_REGION;
+            for (std::size_t s = 0; s < buckets[b].size(); s++) {
+                char *slot = slots.data() + 1 + s * INDEX_SLOT_SIZE;
+                storeU32(slot, buckets[b][s].hash);
+                storeU32(slot + 4, buckets[b][s].region);
+            }
+            status = writeRegion(regions[next], slots.data());
+            if (status != Status::Ok) {
+                return status;
+            }
+            storeU32(table.data() + 1 + i * 4, regions[next++]);
+        }
+        status = writeRegion(regions[1 + t], table.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+        storeU32(header.data() + INDEX_TABLES + t * 4, regions[1 + t]);
+        index.tables.push_back(regions[1 + t]);
+    }
+    status = writeRegion(regions[0], header.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    storeU32(marker, regions[0]);
+    index.header = regions[0];
+    index.bucketCount = bucketCount;
+    index.tail = tail;
+    return writeAt(markerAt, marker, sizeof(marker));
+}
+
+Status Image::addToIndex(uint32_t directoryRegion, DirectoryIndex &index,
+                         std::string_view name, uint32_t region) {
+    const uint32_t hash = nameHash(name);
+    const uint32_t bucket = hash % index.bucketCount;
+    const uint32_t tableRegion = index.tables[bucket / geometry.tableBuckets];
+    const uint32_t pointer = 1 + bucket % geometry.tableBuckets * 4;
+    std::vector<char> table(geometry.regionSize);
+    Status status = readRegion(tableRegion, table.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    std::vector<char> slots(geometry.regionSize);
+    uint32_t bucketRegion = loadU32(table.data() + pointer);
+    if (bucketRegion == 0) {
+        // Buckets are only allocated once a name hashes to them.
+        std::vector<uint32_t> regions;
+        status = allocateRegions(partitionOf(directoryRegion), 1, regions);
+        if (status != Status::Ok) {
+            return status;
+        }
+        bucketRegion = regions[0];
+        slots[0] = INDEX_REGION;
+        storeU32(table.data() + pointer, bucketRegion);
+        status = writeRegion(tableRegion, table.data());
+    } else {
+        status = readRegion(bucketRegion, slots.data());
+    }
+    if (status != Status::Ok) {
+        return status;
+    }
+
+    for (uint32_t i = 0; i < geometry.bucketSlots; i++) {
+        char *slot = slots.data() + 1 + i * INDEX_SLOT_SIZE;
+        if (loadU32(slot + 4) == 0) {
+            storeU32(slot, hash);
+            storeU32(slot + 4, region);
+            return writeRegion(bucketRegion, slots.data());
+        }
+    }
+    // The entry is already in the directory, so rebuilding picks it up.
+    return buildIndex(directoryRegion, index.tail, index.bucketCount * 2,
+                      index);
+}
+
+Status Image::removeFromIndex(uint32_t directoryRegion, std::string_view name,
+                              uint32_t region) {
+    std::vector<char> firstRegion(geometry.regionSize);
+    DirectoryIndex index;
+    Status status = loadIndex(directoryRegion, firstRegion.data(), index);
+    if (status != Status::Ok || index.header == 0) {
+        return status;
+    }
+    const uint32_t hash = nameHash(name);
+    const uint32_t bucket = hash % index.bucketCount;
+    std::vector<char> table(geometry.regionSize);
+    status = readRegion(index.tables[bucket / geometry.tableBuckets],
+                        table.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    const uint32_t bucketRegion =
+        loadU32(table.data() + 1 + bucket % geometry.tableBuckets * 4);
+    if (bucketRegion == 0) {
+        return Status::Ok;
+    }
+    std::vector<char> slots(geometry.regionSize);
+    status = readRegion(bucketRegion, slots.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    for (uint32_t i = 0; i < geometry.bucketSlots; i++) {
+        char *slot = slots.data() + 1 + i * INDEX_SLOT_SIZE;
+        if (loadU32(slot) == hash && loadU32(slot + 4) == region) {
+            std::memset(slot, 0, INDEX_SLOT_SIZE);
+            return writeRegion(bucketRegion, slots.data());
+        }
+    }
+    return Status::Ok;
+}
+
+Status Image::freeIndex(const DirectoryIndex &index) {
+    for (uint32_t tableRegion : index.tables) {
+        std::vector<char> table(geometry.regionSize);
+        Status status = readRegion(tableRegion, table.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+        for (uint32_t i = 0; i < geometry.tableBuckets; i++) {
+            const uint32_t bucketRegion = loadU32(table.data() + 1 + i * 4);
+            status = bucketRegion == 0 ? Status::Ok : freeChain(bucketRegion);
+            if (status != Status::Ok) {
+                return status;
+            }
+        }
+        status = freeChain(tableRegion);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    return freeChain(index.header);
+}
+
+} // namespace ionicfs
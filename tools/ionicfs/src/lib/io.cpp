@@ -0,0 +1,220 @@
+#include "io.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/fs.h>
+#elif defined(__APPLE__)
+#include <sys/disk.h>
+#endif
+
+namespace ionicfs {
+
+Status readFully(int fd, uint64_t offset, char *buffer, std::size_t size) {
+    while (size > 0) {
+        ssize_t count = ::pread(fd, buffer, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return Status::IoError;
+        }
+        buffer += count;
+        offset += count;
+        size -= count;
+    }
+    return Status::Ok;
+}
+
+Status writeFully(int fd, uint64_t offset, const char *buffer,
+                  std::size_t size) {
+    while (size > 0) {
+        ssize_t count = ::pwrite(fd, buffer, size, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return Status::IoError;
+        }
+        buffer += count;
+        offset += count;
+        size -= count;
+    }
+    return Status::Ok;
+}
+
+namespace {
+
+uint64_t alignDown(uint64_t value) { return value & ~(DIRECT_ALIGNMENT - 1); }
+
+uint64_t alignUp(uint64_t value) {
+    return alignDown(value + DIRECT_ALIGNMENT - 1);
+}
+
+// One bounce buffer per thread, allocated on first use.
+char *bounceBuffer() {
+    struct Free {
+        void operator()(char *buffer) const { std::free(buffer); }
+    };
+    thread_local std::unique_ptr<char, Free> buffer(static_cast<char *>(
+        std::aligned_alloc(DIRECT_ALIGNMENT, DIRECT_BUFFER_SIZE)));
+    return buffer.get();
+}
+
+} // namespace
+
+int openDisk(const fs::path &path, int flags, bool direct) {
+#ifdef O_DIRECT
+    if (direct) {
+        flags |= O_DIRECT;
+    }
+#endif
+    int fd = ::open(path.c_str(), flags);
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    if (fd >= 0 && direct && ::fcntl(fd, F_NOCACHE, 1) != 0) {
+        ::close(fd);
+        return -1;
+    }
+#endif
+    return fd;
+}
+
+void adviseWillNeed(int fd, uint64_t offset, uint64_t size) {
+#if defined(POSIX_FADV_WILLNEED)
+    ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                    POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+    radvisory advice{};
+    advice.ra_offset = static_cast<off_t>(offset);
+    advice.ra_count = static_cast<int>(std::min<uint64_t>(size, INT32_MAX));
+    ::fcntl(fd, F_RDADVISE, &advice);
+#else
+    (void)fd;
+    (void)offset;
+    (void)size;
+#endif
+}
+
+Status readDirect(int fd, uint64_t offset, char *buffer, std::size_t size) {
+    char *bounce = bounceBuffer();
+    if (bounce == nullptr) {
+        return Status::IoError;
+    }
+    while (size > 0) {
+        const uint64_t start = alignDown(offset);
+        const std::size_t skip = offset - start;
+        const std::size_t span = std::min(size, DIRECT_BUFFER_SIZE - skip);
+        Status status = readFully(fd, start, bounce, alignUp(skip + span));
+        if (status != Status::Ok) {
+            return status;
+        }
+        std::memcpy(buffer, bounce + skip, span);
+        buffer += span;
+        offset += span;
+        size -= span;
+    }
+    return Status::Ok;
+}
+
+Status writeDirect(int fd, uint64_t offset, const char *buffer,
+                   std::size_t size) {
+    char *bounce = bounceBuffer();
+    if (bounce == nullptr) {
+        return Status::IoError;
+    }
+    while (size > 0) {
+        const uint64_t start = alignDown(offset);
+        const std::size_t skip = offset - start;
+        const std::size_t span = std::min(size, DIRECT_BUFFER_SIZE - skip);
+        const std::size_t length = alignUp(skip + span);
+        const std::size_t lastBlock = length - DIRECT_ALIGNMENT;
+        Status status = Status::Ok;
+        if (skip != 0) {
+            status = readFully(fd, start, bounce, DIRECT_ALIGNMENT);
+        }
+        if (status == Status::Ok && skip + span != length &&
+            (lastBlock != 0 || skip == 0)) {
+            status = readFully(fd, start + lastBlock, bounce + lastBlock,
+                               DIRECT_ALIGNMENT);
+        }
+        if (status == Status::Ok) {
+            std::memcpy(bounce + skip, buffer, span);
+            status = writeFully(fd, start, bounce, length);
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+        buffer += span;
+        offset += span;
+        size -= span;
+    }
+    return Status::Ok;
+}
+
+Status lockFile(int fd, bool exclusive, std::chrono::milliseconds timeout) {
+    using namespace std::chrono_literals;
+    const int operation = exclusive ? LOCK_EX : LOCK_SH;
+    if (timeout.count() < 0) {
+        while (::flock(fd, operation) != 0) {
+            if (errno != EINTR) {
+                return Status::IoError;
+            }
+        }
+        return Status::Ok;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::chrono::milliseconds pause = 1ms;
+    while (::flock(fd, operation | LOCK_NB) != 0) {
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EWOULDBLOCK) {
+            return Status::IoError;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return Status::Locked;
+        }
+        std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(
+            pause, deadline - now));
+        pause = std::min(pause * 2, std::chrono::milliseconds(50));
+    }
+    return Status::Ok;
+}
+
+Status blockDeviceSize(const fs::path &path, std::uintmax_t &size) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return Status::IoError;
+    }
+#if defined(__linux__)
+    uint64_t bytes = 0;
+    bool known = ::ioctl(fd, BLKGETSIZE64, &bytes) == 0;
+#elif defined(__APPLE__)
+    uint32_t blockSize = 0;
+    uint64_t blockCount = 0;
+    bool known = ::ioctl(fd, DKIOCGETBLOCKSIZE, &blockSize) == 0 &&
+                 ::ioctl(fd, DKIOCGETBLOCKCOUNT, &blockCount) == 0;
+    uint64_t bytes = static_cast<uint64_t>(blockSize) * blockCount;
+#else
+    off_t end = ::lseek(fd, 0, SEEK_END);
+    bool known = end >= 0;
+    uint64_t bytes = known ? static_cast<uint64_t>(end) : 0;
+#endif
+    ::close(fd);
+    if (!known) {
+        return Status::IoError;
+    }
+    size = bytes;
+    return Status::Ok;
+}
+
+} // namespace ionicfs
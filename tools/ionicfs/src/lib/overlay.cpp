@@ -0,0 +1,194 @@
+#include "overlay.hpp"
+#include "io.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ionicfs {
+
+Overlay::~Overlay() { close(); }
+
+Status Overlay::open(const fs::path &path, uint64_t baseRegions,
+                     bool writable, std::chrono::milliseconds lockTimeout) {
+    close();
+    std::error_code error;
+    if (!fs::exists(path, error)) {
+        if (!writable) {
+            return Status::Ok;
+        }
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            return Status::IoError;
+        }
+        char header[OVERLAY_BLOCK_SIZE] = {0};
+        std::memcpy(header, OVERLAY_MAGIC, 8);
+        storeU64(header + 8, baseRegions);
+        Status status = lockFile(fd, true, lockTimeout);
+        if (status == Status::Ok) {
+            status = writeFully(fd, 0, header, sizeof(header));
+        }
+        if (status != Status::Ok) {
+            close();
+        }
+        return status;
+    }
+
+    fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return Status::IoError;
+    }
+    Status status = lockFile(fd, writable, lockTimeout);
+    if (status != Status::Ok) {
+        close();
+        return status;
+    }
+    std::uintmax_t size = fs::file_size(path, error);
+    char header[OVERLAY_BLOCK_SIZE];
+    status = error ? Status::IoError
+                   : readFully(fd, 0, header, sizeof(header));
+    if (status == Status::Ok &&
+        (std::memcmp(header, OVERLAY_MAGIC, 8) != 0 ||
+         loadU64(header + 8) != baseRegions)) {
+        status = Status::InvalidImage;
+    }
+
+    // Slots are filled in order, so the first free map entry ends the map.
+    char map[OVERLAY_BLOCK_SIZE];
+    bool more = true;
+    for (uint64_t slot = 0; status == Status::Ok && more &&
+                            mapOffset(slot) + OVERLAY_BLOCK_SIZE <= size;
+         slot += OVERLAY_GROUP_SLOTS) {
+        status = readFully(fd, mapOffset(slot), map, sizeof(map));
+        for (uint32_t i = 0; status == Status::Ok && i < OVERLAY_GROUP_SLOTS;
+             i++) {
+            uint32_t entry = loadU32(map + i * 4);
+            if (entry == 0) {
+                more = false;
+                break;
+            }
+            slots[entry - 1] = slot + i;
+        }
+    }
+    if (status != Status::Ok) {
+        close();
+    }
+    return status;
+}
+
+void Overlay::close() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    slots.clear();
+}
+
+uint64_t Overlay::mapOffset(uint64_t slot) const {
+    return OVERLAY_BLOCK_SIZE + slot / OVERLAY_GROUP_SLOTS *
+                             (OVERLAY_GROUP_SLOTS + 1) * OVERLAY_BLOCK_SIZE;
+}
+
+uint64_t Overlay::slotOffset(uint64_t slot) const {
+    return mapOffset(slot) + OVERLAY_BLOCK_SIZE +
+           slot % OVERLAY_GROUP_SLOTS * OVERLAY_BLOCK_SIZE;
+}
+
+Status Overlay::read(uint32_t region, uint32_t offset, char *buffer,
+                     std::size_t size) {
+    return readFully(fd, slotOffset(slots.at(region)) + offset, buffer, size);
+}
+
+Status Overlay::write(uint32_t region, uint32_t offset, const char *buffer,
+                      std::size_t size) {
+    return writeFully(fd, slotOffset(slots.at(region)) + offset, buffer,
+                      size);
+}
+
+Status Overlay::add(uint32_t region, const char *data) {
+    if (fd < 0) {
+        return Status::ReadOnly;
+    }
+    const uint64_t slot = slots.size();
+    Status status = writeFully(fd, slotOffset(slot), data, OVERLAY_BLOCK_SIZE);
+    if (status != Status::Ok) {
+        return status;
+    }
+    char entry[4];
+    storeU32(entry, region + 1);
+    status = writeFully(fd, mapOffset(slot) + slot % OVERLAY_GROUP_SLOTS * 4,
+                        entry, sizeof(entry));
+    if (status == Status::Ok) {
+        slots[region] = slot;
+    }
+    return status;
+}
+
+Status Overlay::sync() {
+    if (fd >= 0 && ::fsync(fd) != 0) {
+        return Status::IoError;
+    }
+    return Status::Ok;
+}
+
+Status Overlay::forEach(
+    const std::function<Status(uint32_t, const char *)> &apply) {
+    std::vector<uint32_t> regions;
+    regions.reserve(slots.size());
+    for (const auto &[region, slot] : slots) {
+        regions.push_back(region);
+    }
+    std::sort(regions.begin(), regions.end());
+
+    char data[OVERLAY_BLOCK_SIZE];
+    for (uint32_t region : regions) {
+        Status status = read(region, 0, data, sizeof(data));
+        if (status == Status::Ok) {
+            status = apply(region, data);
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    return Status::Ok;
+}
+
+Status commitOverlay(const fs::path &diskPath, const fs::path &overlayPath) {
+    std::uintmax_t size = 0;
+    Status status = diskSize(diskPath, size);
+    if (status != Status::Ok) {
+        return status;
+    }
+    std::error_code error;
+    if (!fs::exists(overlayPath, error)) {
+        return Status::ImageNotFound;
+    }
+
+    Overlay overlay;
+    status = overlay.open(overlayPath, size / OVERLAY_BLOCK_SIZE, false,
+                          std::chrono::milliseconds(-1));
+    if (status != Status::Ok) {
+        return status;
+    }
+    int fd = ::open(diskPath.c_str(), O_RDWR);
+    if (fd < 0) {
+        return Status::IoError;
+    }
+    status = lockFile(fd, true, std::chrono::milliseconds(-1));
+    if (status == Status::Ok) {
+        status = overlay.forEach([&](uint32_t block, const char *data) {
+            return writeFully(fd,
+                              static_cast<uint64_t>(block) * OVERLAY_BLOCK_SIZE,
+                              data, OVERLAY_BLOCK_SIZE);
+        });
+    }
+    if (status == Status::Ok && ::fsync(fd) != 0) {
+        status = Status::IoError;
+    }
+    ::close(fd);
+    return status;
+}
+
+} // namespace ionicfs
@@ -0,0 +1,220 @@
+#include "io.hpp"
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <istream>
+#include <ostream>
+#include <unistd.h>
+#include <vector>
+
+namespace ionicfs {
+
+namespace {
+
+// Regions are moved 128 KiB at a time, or one at a time when larger.
+uint32_t chunkRegionsFor(uint32_t regionSize) {
+    return std::max<uint32_t>(1, 128 * 1024 / regionSize);
+}
+
+// Free-space bitmaps of the partitions, from format 003 on. They alone
+// tell whether an extent region, which has no type byte, is in use.
+using Bitmaps = std::vector<std::vector<char>>;
+
+// Regions a partition does not use are not worth shipping, nor are zeroed
+// regions anywhere on the disk. Both come back as zeroes.
+bool isFree(const DriveInformation &drive, const Bitmaps &bitmaps,
+            uint64_t region, const char *data) {
+    const Geometry geometry = geometryFor(drive.regionSize);
+    for (uint32_t i = 0; i < PARTITION_COUNT; i++) {
+        const Partition &partition = drive.partitions[i];
+        if (!partition.usable || region < partition.partitionRegion ||
+            region - partition.partitionRegion >= partition.partitionSize) {
+            continue;
+        }
+        if (!bitmaps[i].empty()) {
+            const uint64_t bit = region - partition.partitionRegion;
+            const char byte =
+                bitmaps[i][bit / geometry.bitmapBits * geometry.regionSize +
+                           1 + bit % geometry.bitmapBits / 8];
+            if ((byte & (1u << (bit % 8))) == 0) {
+                return true;
+            }
+        } else if (data[0] == EMPTY_REGION || data[0] == DELETED_REGION) {
+            return true;
+        }
+        break;
+    }
+    return std::all_of(data, data + drive.regionSize,
+                       [](char byte) { return byte == 0; });
+}
+
+void writeRun(std::ostream &archive, char tag, uint32_t count) {
+    char run[5];
+    run[0] = tag;
+    storeU32(run + 1, count);
+    archive.write(run, sizeof(run));
+}
+
+} // namespace
+
+Status pack(Image &image, std::ostream &archive) {
+    const DriveInformation &drive = image.information();
+    char header[PACK_HEADER_SIZE] = {0};
+    std::memcpy(header, PACK_MAGIC, 8);
+    storeU64(header + 8, drive.totalRegions);
+    storeU64(header + 16, drive.diskSize);
+    archive.write(header, sizeof(header));
+    if (drive.regionSize != DEFAULT_REGION_SIZE) {
+        writeRun(archive, PACK_REGION_SIZE, drive.regionSize);
+    }
+
+    const uint32_t regionSize = drive.regionSize;
+    Bitmaps bitmaps(PARTITION_COUNT);
+    for (uint32_t i = 0;
+         i < PARTITION_COUNT && std::strcmp(drive.version + 5, "003") >= 0;
+         i++) {
+        const Partition &partition = drive.partitions[i];
+        if (!partition.usable) {
+            continue;
+        }
+        std::vector<uint32_t> regions;
+        Status status = image.bitmapRegions(static_cast<int>(i), regions);
+        bitmaps[i].resize(regions.size() * regionSize);
+        for (std::size_t j = 0; status == Status::Ok && j < regions.size();
+             j++) {
+            status = image.readRegion(regions[j],
+                                      bitmaps[i].data() + j * regionSize);
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+
+    const uint32_t chunkRegions = chunkRegionsFor(regionSize);
+    std::vector<char> chunk(chunkRegions * regionSize);
+    uint32_t freeRegions = 0;
+    for (uint64_t first = 0; first < drive.totalRegions;
+         first += chunkRegions) {
+        const uint32_t count = static_cast<uint32_t>(
+            std::min<uint64_t>(chunkRegions, drive.totalRegions - first));
+        Status status = image.readRegions(first, count, chunk.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+
+        auto regionFree = [&](uint32_t index) {
+            return isFree(drive, bitmaps, first + index,
+                          chunk.data() + index * regionSize);
+        };
+        uint32_t index = 0;
+        while (index < count) {
+            if (regionFree(index)) {
+                freeRegions++;
+                index++;
+                continue;
+            }
+            if (freeRegions > 0) {
+                writeRun(archive, PACK_FREE_RUN, freeRegions);
+                freeRegions = 0;
+            }
+            uint32_t end = index + 1;
+            while (end < count && !regionFree(end)) {
+                end++;
+            }
+            writeRun(archive, PACK_DATA_RUN, end - index);
+            archive.write(chunk.data() + index * regionSize,
+                          static_cast<std::streamsize>(end - index) *
+                              regionSize);
+            index = end;
+        }
+    }
+    if (freeRegions > 0) {
+        writeRun(archive, PACK_FREE_RUN, freeRegions);
+    }
+    archive.put(PACK_END);
+    archive.flush();
+    return archive ? Status::Ok : Status::IoError;
+}
+
+Status unpack(std::istream &archive, const fs::path &diskPath) {
+    char header[PACK_HEADER_SIZE];
+    if (!archive.read(header, sizeof(header)) ||
+        std::memcmp(header, PACK_MAGIC, 8) != 0) {
+        return Status::InvalidImage;
+    }
+    const uint64_t totalRegions = loadU64(header + 8);
+    const uint64_t size = loadU64(header + 16);
+    // A region size record may only come first.
+    uint32_t regionSize = DEFAULT_REGION_SIZE;
+    if (archive.peek() == PACK_REGION_SIZE) {
+        char record[5];
+        if (!archive.read(record, sizeof(record))) {
+            return Status::InvalidImage;
+        }
+        regionSize = loadU32(record + 1);
+    }
+    if (!validRegionSize(regionSize) || totalRegions != size / regionSize) {
+        return Status::InvalidImage;
+    }
+
+    int fd = ::open(diskPath.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        return Status::IoError;
+    }
+    // Free runs are never written and stay holes of the sparse file, so
+    // the previous contents are only dropped once the disk is locked.
+    Status status = lockFile(fd, true, std::chrono::milliseconds(-1));
+    if (status == Status::Ok &&
+        (::ftruncate(fd, 0) != 0 ||
+         ::ftruncate(fd, static_cast<off_t>(size)) != 0)) {
+        status = Status::IoError;
+    }
+    const uint32_t chunkRegions = chunkRegionsFor(regionSize);
+    std::vector<char> chunk(chunkRegions * regionSize);
+    uint64_t region = 0;
+    while (status == Status::Ok) {
+        char run[5];
+        if (!archive.read(run, 1)) {
+            status = Status::Corrupted;
+            break;
+        }
+        if (run[0] == PACK_END) {
+            break;
+        }
+        if (!archive.read(run + 1, 4)) {
+            status = Status::Corrupted;
+            break;
+        }
+        uint32_t count = loadU32(run + 1);
+        if ((run[0] != PACK_DATA_RUN && run[0] != PACK_FREE_RUN) ||
+            region + count > totalRegions) {
+            status = Status::Corrupted;
+            break;
+        }
+        if (run[0] == PACK_FREE_RUN) {
+            region += count;
+            continue;
+        }
+        while (count > 0 && status == Status::Ok) {
+            const uint32_t span = std::min(count, chunkRegions);
+            const std::size_t bytes =
+                static_cast<std::size_t>(span) * regionSize;
+            if (!archive.read(chunk.data(), bytes)) {
+                status = Status::Corrupted;
+                break;
+            }
+            status = writeFully(fd, region * regionSize, chunk.data(), bytes);
+            region += span;
+            count -= span;
+        }
+    }
+    if (status == Status::Ok && ::fsync(fd) != 0) {
+        status = Status::IoError;
+    }
+    ::close(fd);
+    return status;
+}
+
+} // namespace ionicfs
@@ -0,0 +1,222 @@
+#include "protocol.hpp"
+#include "layout.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace ionicfs {
+
+namespace {
+
+// Fixed part of an encoded entry: directory flag, three timestamps, region,
+// the u16 name length and the file size.
+constexpr std::size_t ENCODED_ENTRY_SIZE = 39;
+
+// Header and body leave in a single sendmsg so small requests cost one
+// system call and large payloads are never copied into a frame buffer.
+Status sendFrame(int socket, const char *header, const char *body,
+                 std::size_t bodySize, const char *data = nullptr,
+                 std::size_t dataSize = 0) {
+    iovec parts[3] = {
+        {const_cast<char *>(header), FRAME_HEADER_SIZE},
+        {const_cast<char *>(body), bodySize},
+        {const_cast<char *>(data), dataSize},
+    };
+    iovec *part = parts;
+    std::size_t count = 3;
+    while (count > 0) {
+        msghdr message{};
+        message.msg_iov = part;
+        message.msg_iovlen = count;
+        ssize_t sent = ::sendmsg(socket, &message, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0) {
+            return Status::IoError;
+        }
+        while (count > 0 && static_cast<std::size_t>(sent) >= part->iov_len) {
+            sent -= part->iov_len;
+            part++;
+            count--;
+        }
+        if (count > 0) {
+            part->iov_base = static_cast<char *>(part->iov_base) + sent;
+            part->iov_len -= sent;
+        }
+    }
+    return Status::Ok;
+}
+
+Status receiveFully(int socket, char *buffer, std::size_t size) {
+    while (size > 0) {
+        ssize_t count = ::recv(socket, buffer, size, 0);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return Status::IoError;
+        }
+        buffer += count;
+        size -= count;
+    }
+    return Status::Ok;
+}
+
+} // namespace
+
+Status sendRequest(int socket, const Request &request) {
+    if (request.path.size() > UINT16_MAX ||
+        request.path.size() + request.data.size() > MAX_FRAME_SIZE) {
+        return Status::InvalidArgument;
+    }
+    char header[FRAME_HEADER_SIZE];
+    storeU32(header, request.path.size() + request.data.size());
+    header[4] = static_cast<char>(request.operation);
+    header[5] = static_cast<char>(request.partition);
+    header[6] = static_cast<char>(request.path.size());
+    header[7] = static_cast<char>(request.path.size() >> 8);
+    return sendFrame(socket, header, request.path.data(), request.path.size(),
+                     request.data.data(), request.data.size());
+}
+
+Status receiveRequest(int socket, Request &request) {
+    char header[FRAME_HEADER_SIZE];
+    Status status = receiveFully(socket, header, sizeof(header));
+    if (status != Status::Ok) {
+        return status;
+    }
+    const uint32_t length = loadU32(header);
+    const uint16_t pathLength = static_cast<uint8_t>(header[6]) |
+                                static_cast<uint8_t>(header[7]) << 8;
+    if (length > MAX_FRAME_SIZE || pathLength > length) {
+        return Status::InvalidArgument;
+    }
+    request.operation = static_cast<Operation>(header[4]);
+    request.partition = static_cast<uint8_t>(header[5]);
+    request.path.resize(pathLength);
+    request.data.resize(length - pathLength);
+    status = receiveFully(socket, request.path.data(), pathLength);
+    if (status == Status::Ok) {
+        status = receiveFully(socket, request.data.data(),
+                              request.data.size());
+    }
+    return status;
+}
+
+Status sendResponse(int socket, Status status, const char *payload,
+                    std::size_t size) {
+    if (size > MAX_FRAME_SIZE) {
+        return Status::InvalidArgument;
+    }
+    char header[FRAME_HEADER_SIZE] = {0};
+    storeU32(header, size);
+    header[4] = static_cast<char>(status);
+    return sendFrame(socket, header, payload, size);
+}
+
+Status receiveResponse(int socket, Response &response) {
+    char header[FRAME_HEADER_SIZE];
+    Status status = receiveFully(socket, header, sizeof(header));
+    if (status != Status::Ok) {
+        return status;
+    }
+    const uint32_t length = loadU32(header);
+    if (length > MAX_FRAME_SIZE) {
+        return Status::InvalidArgument;
+    }
+    response.status = static_cast<Status>(header[4]);
+    response.payload.resize(length);
+    return receiveFully(socket, response.payload.data(), length);
+}
+
+void encodeEntry(const DirectoryEntry &entry, std::vector<char> &payload) {
+    const std::size_t start = payload.size();
+    payload.resize(start + ENCODED_ENTRY_SIZE + entry.name.size());
+    char *out = payload.data() + start;
+    out[0] = entry.isDirectory ? 1 : 0;
+    storeU64(out + 1, entry.lastAccessed);
+    storeU64(out + 9, entry.lastModified);
+    storeU64(out + 17, entry.created);
+    storeU32(out + 25, entry.region);
+    out[29] = static_cast<char>(entry.name.size());
+    out[30] = static_cast<char>(entry.name.size() >> 8);
+    storeU64(out + 31, entry.size);
+    std::memcpy(out + ENCODED_ENTRY_SIZE, entry.name.data(), entry.name.size());
+}
+
+Status decodeEntries(
+    const std::vector<char> &payload,
+    const std::function<void(const DirectoryEntry &)> &visit) {
+    std::size_t offset = 0;
+    while (offset < payload.size()) {
+        if (payload.size() - offset < ENCODED_ENTRY_SIZE) {
+            return Status::Corrupted;
+        }
+        const char *in = payload.data() + offset;
+        const std::size_t nameLength = static_cast<uint8_t>(in[29]) |
+                                       static_cast<uint8_t>(in[30]) << 8;
+        if (payload.size() - offset - ENCODED_ENTRY_SIZE < nameLength) {
+            return Status::Corrupted;
+        }
+        DirectoryEntry entry;
+        entry.isDirectory = in[0] != 0;
+        entry.lastAccessed = loadU64(in + 1);
+        entry.lastModified = loadU64(in + 9);
+        entry.created = loadU64(in + 17);
+        entry.region = loadU32(in + 25);
+        entry.size = loadU64(in + 31);
+        entry.name = std::string_view(in + ENCODED_ENTRY_SIZE, nameLength);
+        visit(entry);
+        offset += ENCODED_ENTRY_SIZE + nameLength;
+    }
+    return Status::Ok;
+}
+
+Client::~Client() { close(); }
+
+Status Client::connect(const fs::path &socketPath) {
+    close();
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.native().size() >= sizeof(address.sun_path)) {
+        return Status::InvalidArgument;
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket < 0) {
+        return Status::IoError;
+    }
+    if (::connect(socket, reinterpret_cast<sockaddr *>(&address),
+                  sizeof(address)) != 0) {
+        Status status =
+            errno == ENOENT ? Status::ImageNotFound : Status::IoError;
+        close();
+        return status;
+    }
+    return Status::Ok;
+}
+
+void Client::close() {
+    if (socket >= 0) {
+        ::close(socket);
+    }
+    socket = -1;
+}
+
+Status Client::call(const Request &request, Response &response) {
+    Status status = sendRequest(socket, request);
+    if (status == Status::Ok) {
+        status = receiveResponse(socket, response);
+    }
+    return status;
+}
+
+} // namespace ionicfs
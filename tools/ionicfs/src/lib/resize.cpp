@@ -0,0 +1,246 @@
+#include "io.hpp"
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include <algorithm>
+#include <unistd.h>
+#include <vector>
+
+namespace ionicfs {
+
+Status Image::growDisk(std::uintmax_t size) {
+    if (!writable) {
+        return Status::ReadOnly;
+    }
+    if (overlay || size < drive.diskSize ||
+        (direct && size % DIRECT_ALIGNMENT != 0)) {
+        return Status::InvalidArgument;
+    }
+    if (size == drive.diskSize) {
+        return Status::Ok;
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        return Status::IoError;
+    }
+    // The region straddling the old end keeps the bytes it had.
+    const uint64_t oldEnd =
+        (drive.diskSize + geometry.regionSize - 1) / geometry.regionSize;
+    zeroedFrom = std::min(zeroedFrom, oldEnd);
+    drive.diskSize = size;
+    drive.totalRegions = size / geometry.regionSize;
+    return Status::Ok;
+}
+
+Status Image::resize(int partitionIndex, uint32_t partitionSize) {
+    const Partition *partition = nullptr;
+    Status status = partitionAt(partitionIndex, partition);
+    if (status != Status::Ok) {
+        return status;
+    }
+    const uint32_t start = partition->partitionRegion;
+    const uint64_t end = uint64_t{start} + partitionSize;
+    const uint32_t bitmapCount =
+        freeBitmap ? geometry.bitmapRegionsFor(partitionSize) : 0;
+    if (partitionSize <= bitmapCount || end > drive.totalRegions) {
+        return Status::InvalidArgument;
+    }
+    for (uint32_t i = 0; i < PARTITION_COUNT; i++) {
+        const Partition &other = drive.partitions[i];
+        if (i != static_cast<uint32_t>(partitionIndex) && other.usable &&
+            other.partitionRegion < end &&
+            start < uint64_t{other.partitionRegion} + other.partitionSize) {
+            return Status::InvalidArgument;
+        }
+    }
+    if (partitionSize == partition->partitionSize) {
+        return Status::Ok;
+    }
+
+    Transaction transaction(*this);
+    status = partitionSize > partition->partitionSize
+                 ? growPartition(partitionIndex, partitionSize)
+                 : shrinkPartition(partitionIndex, partitionSize);
+    if (status == Status::Ok) {
+        char field[4];
+        storeU32(field, partitionSize);
+        status = writeAt(partitionEntryOffset(partitionIndex) +
+                             PartitionSize::offset,
+                         field, sizeof(field));
+    }
+    if (status == Status::Ok) {
+        status = transaction.commit();
+    }
+    // The bitmap is followed again on its next use, with the new bounds.
+    bitmapChains[partitionIndex].clear();
+    if (status == Status::Ok) {
+        drive.partitions[partitionIndex].partitionSize = partitionSize;
+    }
+    return status;
+}
+
+Status Image::growPartition(int partitionIndex, uint32_t partitionSize) {
+    const Partition &partition = drive.partitions[partitionIndex];
+    const uint32_t start = partition.partitionRegion;
+    const uint32_t oldEnd = start + partition.partitionSize;
+    const uint32_t newEnd = start + partitionSize;
+
+    // Regions outside every partition may hold anything, such as what a
+    // shrunk partition left behind. Those that look in use are marked
+    // deleted. Regions growDisk added read as zeroes and are skipped,
+    // which keeps growing into a grown disk quick.
+    const uint32_t batchRegions =
+        std::max<uint32_t>(1, 65536 / geometry.regionSize);
+    std::vector<char> batch(batchRegions * geometry.regionSize);
+    const char deleted = DELETED_REGION;
+    const uint32_t scanEnd =
+        static_cast<uint32_t>(std::min<uint64_t>(newEnd, zeroedFrom));
+    for (uint32_t first = oldEnd; first < scanEnd; first += batchRegions) {
+        const uint32_t span = std::min(batchRegions, scanEnd - first);
+        Status status = readRegions(first, span, batch.data());
+        for (uint32_t i = 0; status == Status::Ok && i < span; i++) {
+            const char type = batch[i * geometry.regionSize];
+            if (type != EMPTY_REGION && type != DELETED_REGION) {
+                status = writeAt(geometry.offsetOf(first + i), &deleted, 1);
+            }
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    if (!freeBitmap) {
+        return Status::Ok;
+    }
+
+    // More bitmap regions open the new space, linked from the last one.
+    // They are outside the partition until the table changes, so their
+    // bits are set here rather than by trackAllocation.
+    Status status = loadBitmap(partitionIndex);
+    if (status != Status::Ok) {
+        return status;
+    }
+    std::vector<uint32_t> bitmap = bitmapChains[partitionIndex];
+    const uint32_t added = geometry.bitmapRegionsFor(partitionSize) -
+                           static_cast<uint32_t>(bitmap.size());
+    if (added == 0) {
+        return Status::Ok;
+    }
+    char link[4];
+    storeU32(link, oldEnd);
+    status = writeAt(geometry.offsetOf(bitmap.back()) + geometry.next, link,
+                     sizeof(link));
+    if (status != Status::Ok) {
+        return status;
+    }
+    std::vector<char> regions(std::size_t{added} * geometry.regionSize, 0);
+    for (uint32_t i = 0; i < added; i++) {
+        regions[i * geometry.regionSize] = BITMAP_REGION;
+        bitmap.push_back(oldEnd + i);
+    }
+    markFresh(bitmap, bitmap.size() - added);
+    status = writeAt(geometry.offsetOf(oldEnd), regions.data(), regions.size());
+    for (uint32_t i = 0; status == Status::Ok && i < added; i++) {
+        const uint32_t index = oldEnd + i - start;
+        const uint64_t byteOffset =
+            geometry.offsetOf(bitmap[index / geometry.bitmapBits]) + 1 +
+            index % geometry.bitmapBits / 8;
+        char byte = 0;
+        status = readAt(byteOffset, &byte, 1);
+        if (status == Status::Ok) {
+            byte |= static_cast<char>(1u << (index % 8));
+            status = writeAt(byteOffset, &byte, 1);
+        }
+    }
+    return status;
+}
+
+Status Image::shrinkPartition(int partitionIndex, uint32_t partitionSize) {
+    const Partition &partition = drive.partitions[partitionIndex];
+    const uint32_t start = partition.partitionRegion;
+    const uint32_t oldSize = partition.partitionSize;
+    const uint32_t bits = geometry.bitmapBits;
+
+    if (!freeBitmap) {
+        // Without a bitmap the type bytes tell which regions are free.
+        const uint32_t batchRegions =
+            std::max<uint32_t>(1, 65536 / geometry.regionSize);
+        std::vector<char> batch(batchRegions * geometry.regionSize);
+        for (uint32_t first = partitionSize; first < oldSize;
+             first += batchRegions) {
+            const uint32_t span = std::min(batchRegions, oldSize - first);
+            Status status = readRegions(start + first, span, batch.data());
+            if (status != Status::Ok) {
+                return status;
+            }
+            for (uint32_t i = 0; i < span; i++) {
+                const char type = batch[i * geometry.regionSize];
+                if (type != EMPTY_REGION && type != DELETED_REGION) {
+                    return Status::NoSpace;
+                }
+            }
+        }
+        return Status::Ok;
+    }
+
+    // The bitmap regions still needed must stay inside; the others are
+    // given up with the free regions.
+    Status status = loadBitmap(partitionIndex);
+    if (status != Status::Ok) {
+        return status;
+    }
+    const std::vector<uint32_t> bitmap = bitmapChains[partitionIndex];
+    const uint32_t kept = geometry.bitmapRegionsFor(partitionSize);
+    for (uint32_t i = 0; i < kept; i++) {
+        if (bitmap[i] >= start + partitionSize) {
+            return Status::NoSpace;
+        }
+    }
+    auto dropped = [&](uint32_t region) {
+        return std::find(bitmap.begin() + kept, bitmap.end(), region) !=
+               bitmap.end();
+    };
+    std::vector<char> regionData(geometry.regionSize);
+    for (uint32_t b = partitionSize / bits; b < bitmap.size(); b++) {
+        status = readRegion(bitmap[b], regionData.data());
+        if (status != Status::Ok) {
+            return status;
+        }
+        const uint32_t first = std::max(partitionSize, b * bits);
+        const uint32_t limit = static_cast<uint32_t>(
+            std::min<uint64_t>(oldSize, uint64_t{b + 1} * bits));
+        for (uint32_t index = first; index < limit; index++) {
+            const char byte = regionData[1 + index % bits / 8];
+            if ((byte & (1u << (index % 8))) != 0 && !dropped(start + index)) {
+                return Status::NoSpace;
+            }
+        }
+    }
+
+    const char deleted = DELETED_REGION;
+    for (uint32_t i = kept; i < bitmap.size(); i++) {
+        status = writeAt(geometry.offsetOf(bitmap[i]), &deleted, 1);
+        if (status != Status::Ok) {
+            return status;
+        }
+    }
+    // Bits past the new end are cleared, so they read free if the
+    // partition grows back.
+    const uint32_t lastKept = bitmap[kept - 1];
+    status = readRegion(lastKept, regionData.data());
+    if (status != Status::Ok) {
+        return status;
+    }
+    const uint32_t limit = static_cast<uint32_t>(
+        std::min<uint64_t>(oldSize, uint64_t{kept} * bits));
+    for (uint32_t index = partitionSize; index < limit; index++) {
+        regionData[1 + index % bits / 8] &=
+            static_cast<char>(~(1u << (index % 8)));
+    }
+    geometry.setNext(regionData.data(), 0);
+    status = writeAt(geometry.offsetOf(lastKept), regionData.data(),
+                     geometry.regionSize);
+    if (status == Status::Ok) {
+        zeroedFrom = std::max<uint64_t>(zeroedFrom, start + oldSize);
+    }
+    return status;
+}
+
+} // namespace ionicfs
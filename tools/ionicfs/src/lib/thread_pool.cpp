@@ -0,0 +1,117 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace ionicfs {
+
+namespace {
+
+// Pool and worker index of the calling thread, when it is a worker.
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local std::size_t currentWorker = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t workers) {
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 0; i < workers; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    threads.reserve(workers);
+    for (std::size_t i = 0; i < workers; i++) {
+        threads.emplace_back([this, i] { run(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    // Tasks from outside the pool are dealt round robin.
+    const std::size_t target =
+        currentPool == this
+            ? currentWorker
+            : nextQueue.fetch_add(1, std::memory_order_relaxed) %
+                  queues.size();
+    pending++;
+    // Counted before it is queued, so queued never drops below what the
+    // queues hold.
+    queued++;
+    {
+        Queue &queue = *queues[target];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    // A worker about to sleep counts itself first and then checks queued
+    // under the lock, so it either sees this task or gets the notify.
+    if (sleeping > 0) {
+        std::lock_guard lock(mutex);
+        available.notify_one();
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock lock(mutex);
+    finished.wait(lock, [this] { return pending == 0; });
+}
+
+bool ThreadPool::take(std::size_t worker, Task &task) {
+    {
+        Queue &own = *queues[worker];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < queues.size(); i++) {
+        Queue &victim = *queues[(worker + i) % queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(std::size_t worker) {
+    currentPool = this;
+    currentWorker = worker;
+    while (true) {
+        Task task;
+        if (take(worker, task)) {
+            task(worker);
+            if (--pending == 0) {
+                std::lock_guard lock(mutex);
+                finished.notify_all();
+            }
+            continue;
+        }
+        // Nothing to take: sleep until a task is queued. A task counted
+        // but not pushed yet, or taken by another worker first, only sends
+        // the worker round once more; it leaves once stopping and idle.
+        std::unique_lock lock(mutex);
+        sleeping++;
+        available.wait(lock, [this] { return stopping || queued > 0; });
+        sleeping--;
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
+
+} // namespace ionicfs
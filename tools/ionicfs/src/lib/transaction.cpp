@@ -0,0 +1,221 @@
+#include "ionicfs.hpp"
+#include "layout.hpp"
+#include "overlay.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+
+namespace ionicfs {
+
+Transaction::Transaction(Image &image)
+    : image(image), writesAtStart(image.bufferedWrites) {
+    if (image.transactionDepth++ == 0) {
+        image.transactionAborted = false;
+    }
+}
+
+Transaction::~Transaction() {
+    if (finished) {
+        return;
+    }
+    image.transactionDepth--;
+    if (image.bufferedWrites != writesAtStart) {
+        image.transactionAborted = true;
+    }
+    if (image.transactionDepth == 0) {
+        image.discardPending();
+    }
+}
+
+Status Transaction::commit() {
+    finished = true;
+    image.transactionDepth--;
+    if (image.transactionAborted) {
+        if (image.transactionDepth == 0) {
+            image.discardPending();
+        }
+        return Status::Aborted;
+    }
+    if (image.transactionDepth > 0) {
+        return Status::Ok;
+    }
+    return image.flushPending();
+}
+
+Status Image::readAt(uint64_t offset, char *buffer, std::size_t size) {
+    if (pendingRegions.empty()) {
+        return readLayers(offset, buffer, size);
+    }
+    while (size > 0) {
+        const uint32_t region = offset / geometry.regionSize;
+        const uint32_t within = offset % geometry.regionSize;
+        std::size_t span =
+            std::min<std::size_t>(size, geometry.regionSize - within);
+        auto next = pendingRegions.lower_bound(region);
+        Status status = Status::Ok;
+        if (next != pendingRegions.end() && next->first == region) {
+            std::memcpy(buffer, pendingData.data() + next->second + within,
+                        span);
+        } else {
+            // Everything up to the next buffered region comes from below
+            // in a single read.
+            uint64_t limit = next == pendingRegions.end()
+                                 ? offset + size
+                                 : geometry.offsetOf(next->first);
+            span = std::min<uint64_t>(size, limit - offset);
+            status = readLayers(offset, buffer, span);
+        }
+        if (status != Status::Ok) {
+            return status;
+        }
+        buffer += span;
+        offset += span;
+        size -= span;
+    }
+    return Status::Ok;
+}
+
+Status Image::writeAt(uint64_t offset, const char *buffer, std::size_t size) {
+    if (!writable) {
+        return Status::ReadOnly;
+    }
+    Status status = transactionDepth == 0
+                        ? writeLayers(offset, buffer, size)
+                        : bufferWrite(offset, buffer, size);
+    if (status != Status::Ok) {
+        return status;
+    }
+    return trackAllocation(offset, buffer, size);
+}
+
+Status Image::writeData(uint64_t offset, const char *buffer,
+                        std::size_t size) {
+    if (!writable) {
+        return Status::ReadOnly;
+    }
+    return transactionDepth == 0 ? writeLayers(offset, buffer, size)
+                                 : bufferWrite(offset, buffer, size);
+}
+
+void Image::markFresh(const std::vector<uint32_t> &regions,
+                      std::size_t first) {
+    if (transactionDepth == 0) {
+        return;
+    }
+    // A region this transaction already wrote may have been freed by it,
+    // and the disk still holds its old contents.
+    for (std::size_t i = first; i < regions.size(); i++) {
+        if (pendingRegions.count(regions[i]) == 0) {
+            pendingFresh.insert(regions[i]);
+        }
+    }
+}
+
+Status Image::bufferWrite(uint64_t offset, const char *buffer,
+                          std::size_t size) {
+    if (transactionAborted) {
+        return Status::Aborted;
+    }
+    bufferedWrites++;
+    while (size > 0) {
+        const uint32_t region = offset / geometry.regionSize;
+        const uint32_t within = offset % geometry.regionSize;
+        const std::size_t span =
+            std::min<std::size_t>(size, geometry.regionSize - within);
+        auto [slot, inserted] =
+            pendingRegions.try_emplace(region, pendingData.size());
+        if (inserted) {
+            pendingData.resize(pendingData.size() + geometry.regionSize);
+            if (span != geometry.regionSize) {
+                Status status = readLayers(geometry.offsetOf(region),
+                                           pendingData.data() + slot->second,
+                                           geometry.regionSize);
+                if (status != Status::Ok) {
+                    pendingRegions.erase(slot);
+                    pendingData.resize(pendingData.size() -
+                                       geometry.regionSize);
+                    return status;
+                }
+            }
+        }
+        std::memcpy(pendingData.data() + slot->second + within, buffer, span);
+        buffer += span;
+        offset += span;
+        size -= span;
+    }
+    return Status::Ok;
+}
+
+Status Image::flushPending() {
+    if (pendingRegions.empty()) {
+        return Status::Ok;
+    }
+    // Fresh regions reach the disk before any region that links to them is
+    // rewritten, so a crash in between only leaves unreferenced regions.
+    Status status = flushPending(true);
+    if (status == Status::Ok && !pendingFresh.empty()) {
+        status = overlay ? overlay->sync()
+                         : (::fdatasync(fd) == 0 ? Status::Ok
+                                                 : Status::IoError);
+    }
+    if (status == Status::Ok) {
+        status = flushPending(false);
+    }
+    if (status == Status::Ok) {
+        status = overlay ? overlay->sync()
+                         : (::fsync(fd) == 0 ? Status::Ok : Status::IoError);
+    }
+    pendingRegions.clear();
+    pendingData.clear();
+    pendingFresh.clear();
+    if (status != Status::Ok) {
+        discardPending();
+    }
+    return status;
+}
+
+Status Image::flushPending(bool fresh) {
+    // Consecutive regions are staged together and written in one request
+    // of at most 128 KiB, or a single region when regions are larger.
+    constexpr std::size_t maxRunBytes = 128 * 1024;
+    std::vector<char> run;
+    uint64_t runStart = 0;
+    auto writeRun = [&]() {
+        Status status = run.empty()
+                            ? Status::Ok
+                            : writeLayers(geometry.offsetOf(runStart),
+                                          run.data(), run.size());
+        run.clear();
+        return status;
+    };
+
+    for (const auto &[region, slot] : pendingRegions) {
+        if ((pendingFresh.count(region) != 0) != fresh) {
+            continue;
+        }
+        const char *data = pendingData.data() + slot;
+        const uint64_t runEnd = runStart + run.size() / geometry.regionSize;
+        if (run.empty() || region != runEnd ||
+            run.size() + geometry.regionSize > maxRunBytes) {
+            Status status = writeRun();
+            if (status != Status::Ok) {
+                return status;
+            }
+            runStart = region;
+        }
+        run.insert(run.end(), data, data + geometry.regionSize);
+    }
+    return writeRun();
+}
+
+void Image::discardPending() {
+    pendingRegions.clear();
+    pendingData.clear();
+    pendingFresh.clear();
+    transactionAborted = false;
+    // Caches may describe regions that were never written.
+    std::fill(std::begin(allocationHint), std::end(allocationHint), 0);
+    chains.clear();
+}
+
+} // namespace ionicfs
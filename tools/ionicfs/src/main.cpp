@@ -1,12 +1,14 @@
 
 #include "commands.hpp"
 #include "utils.hpp"
-#include <chrono>
+#include <algorithm>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <optional>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -19,6 +21,30 @@ std::string getVersion() {
 }
 
 int main(int argc, char *argv[]) {
+    // Global options apply to every command and are removed before the
+    // command line is dispatched.
+    std::vector<char *> arguments;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--overlay") == 0 && i + 1 < argc) {
+            useOverlay(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "--direct") == 0) {
+            useDirectIo();
+            continue;
+        }
+        if (strcmp(argv[i], "--lock-timeout") == 0 && i + 1 < argc) {
+            double seconds = std::stod(argv[++i]);
+            useLockTimeout(std::chrono::milliseconds(
+                static_cast<int64_t>(seconds * 1000)));
+            continue;
+        }
+        arguments.push_back(argv[i]);
+    }
+    arguments.push_back(nullptr);
+    argc = static_cast<int>(arguments.size()) - 1;
+    argv = arguments.data();
+
     if (argv[1] == nullptr) {
         std::cout << "IonicFS Tooling" << std::endl;
         std::cout << "Created by Max Van den Eynde for the Avery project."
@@ -28,15 +54,33 @@ int main(int argc, char *argv[]) {
         return 0;
     }
     if (strcmp(argv[1], "help") == 0) {
-        std::cout << "Usage: " << argv[0] << " <command> [options]"
+        std::cout << "Usage: " << argv[0]
+                  << " [--overlay <overlay_path>] [--direct] "
+                     "[--lock-timeout <seconds>] <command> [options]"
                   << std::endl;
         std::cout << "Commands:" << std::endl;
-        std::cout << "  format <disk_path>" << std::endl;
+        std::cout << "  format [--region-size <512|4096|65536>] <disk_path>"
+                  << std::endl;
         std::cout << "  info <disk_path>" << std::endl;
         std::cout << "  list <disk_path> [partition_index]" << std::endl;
+        std::cout << "  stat <disk_path> <path> [partition_index]"
+                  << std::endl;
+        std::cout << "  du <disk_path> <path> [partition_index]" << std::endl;
+        std::cout << "  find <disk_path> <path> -name <pattern> "
+                     "[partition_index]"
+                  << std::endl;
         std::cout << "  mkdir <disk_path> <dir_name> [partition_index]"
                   << std::endl;
-        std::cout << "  copy <disk_path> <file_name> <dest_path> "
+        std::cout << "  copy [--extents] <disk_path> <file_name> "
+                     "<dest_path> [partition_index]"
+                  << std::endl;
+        std::cout << "  cp <disk_path>[:partition_index]:<path> "
+                     "<disk_path>[:partition_index]:<dest_path>"
+                  << std::endl;
+        std::cout << "  write --offset <n> <disk_path> <file_name> "
+                     "<dest_path> [partition_index]"
+                  << std::endl;
+        std::cout << "  append <disk_path> <file_name> <dest_path> "
                      "[partition_index]"
                   << std::endl;
         std::cout << "  read <disk_path> <file_name> [partition_index]"
@@ -44,10 +88,35 @@ int main(int argc, char *argv[]) {
         std::cout << "  read -hex <disk_path> <file_name> "
                      "[partition_index]"
                   << std::endl;
+        std::cout << "  read [--offset <n>] [--length <m>] <disk_path> "
+                     "<file_name> [partition_index]"
+                  << std::endl;
+        std::cout << "  read-many [--tar] <disk_path> <path_list> <output> "
+                     "[partition_index]"
+                  << std::endl;
         std::cout << "  rm <disk_path> <file_name> [partition_index]"
                   << std::endl;
         std::cout << "  rm-dir <disk_path> <dir_name> [partition_index]"
                   << std::endl;
+        std::cout << "  mv <disk_path> <source> <dest_path> [partition_index]"
+                  << std::endl;
+        std::cout << "  sync [--hash] <host_dir> <disk_path> <dest_path> "
+                     "[partition_index]"
+                  << std::endl;
+        std::cout << "  verify <disk_path> <image_dir> <host_dir> "
+                     "[partition_index]"
+                  << std::endl;
+        std::cout << "  commit <disk_path> <overlay_path> [output_path]"
+                  << std::endl;
+        std::cout << "  pack <disk_path> <archive_path>" << std::endl;
+        std::cout << "  unpack <archive_path> <disk_path>" << std::endl;
+        std::cout << "  fsck [--repair] <disk_path>" << std::endl;
+        std::cout << "  resize [--disk-size <bytes>] <disk_path> "
+                     "<partition_index> <regions|max>"
+                  << std::endl;
+        std::cout << "  batch <disk_path> [script_path]" << std::endl;
+        std::cout << "  client <socket_path> <operation> [arguments]"
+                  << std::endl;
         std::cout << "  boot <disk_path> <boot_file_path>" << std::endl;
         std::cout << "  version" << std::endl;
         std::cout << "  help" << std::endl;
@@ -65,14 +134,24 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    bool ok = true;
     if (strcmp(argv[1], "format") == 0) {
-        std::string path(argv[2]);
-        fs::path diskPath(path);
-        formatDisk(diskPath);
+        const bool sized = strcmp(argv[2], "--region-size") == 0;
+        if (sized && argc < 5) {
+            std::cerr << "Usage: " << argv[0]
+                      << " format [--region-size <512|4096|65536>] "
+                         "<disk_path>"
+                      << std::endl;
+            return 1;
+        }
+        const uint32_t regionSize =
+            sized ? static_cast<uint32_t>(std::stoul(argv[3]))
+                  : ionicfs::DEFAULT_REGION_SIZE;
+        ok = formatDisk(argv[sized ? 4 : 2], regionSize);
     } else if (strcmp(argv[1], "info") == 0) {
         std::string path(argv[2]);
         fs::path diskPath(path);
-        info(diskPath);
+        ok = info(diskPath);
     } else if (strcmp(argv[1], "list") == 0) {
         std::string path(argv[2]);
         fs::path diskPath(path);
@@ -80,27 +159,44 @@ int main(int argc, char *argv[]) {
         if (argc > 3) {
             partitionIndex = std::stoi(argv[3]);
         }
-        auto entries = parseRootDirectory(diskPath, partitionIndex).entries;
-        if (entries.empty()) {
-            std::cout << "No entries found in the directory." << std::endl;
+        ok = listDirectory(diskPath, partitionIndex);
+    } else if (strcmp(argv[1], "stat") == 0) {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0]
+                      << " stat <disk_path> <path> [partition_index]"
+                      << std::endl;
             return 1;
         }
-        std::cout << BOLD << "Files at ROOT MODULE. Partition "
-                  << partitionIndex << ":" << RESET << std::endl;
-        for (const auto &entry : entries) {
-            std::cout << entry.name;
-            if (entry.isDirectory) {
-                std::cout << "/";
-            }
-            std::cout << " (Last Accessed: "
-                      << unixTimeToString(entry.lastAccessed)
-                      << ", Last Modified: "
-                      << unixTimeToString(entry.lastModified)
-                      << ", Created: " << unixTimeToString(entry.created)
-                      << ", Region: " << std::hex << entry.region
-                      << ", Is Directory: "
-                      << (entry.isDirectory ? "Yes" : "No") << ")" << std::endl;
+        int partitionIndex = 0;
+        if (argc > 4) {
+            partitionIndex = std::stoi(argv[4]);
+        }
+        ok = statPath(argv[2], argv[3], partitionIndex);
+    } else if (strcmp(argv[1], "du") == 0) {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0]
+                      << " du <disk_path> <path> [partition_index]"
+                      << std::endl;
+            return 1;
         }
+        int partitionIndex = 0;
+        if (argc > 4) {
+            partitionIndex = std::stoi(argv[4]);
+        }
+        ok = diskUsage(argv[2], argv[3], partitionIndex);
+    } else if (strcmp(argv[1], "find") == 0) {
+        if (argc < 6 || strcmp(argv[4], "-name") != 0) {
+            std::cerr << "Usage: " << argv[0]
+                      << " find <disk_path> <path> -name <pattern> "
+                         "[partition_index]"
+                      << std::endl;
+            return 1;
+        }
+        int partitionIndex = 0;
+        if (argc > 6) {
+            partitionIndex = std::stoi(argv[6]);
+        }
+        ok = findEntries(argv[2], argv[3], argv[5], partitionIndex);
     } else if (strcmp(argv[1], "mkdir") == 0) {
         std::string path(argv[2]);
         fs::path diskPath(path);
@@ -109,8 +205,60 @@ int main(int argc, char *argv[]) {
         if (argc > 4) {
             partitionIndex = std::stoi(argv[4]);
         }
-        createDirectory(diskPath, dirName, partitionIndex);
+        ok = createDirectory(diskPath, dirName, partitionIndex);
     } else if (strcmp(argv[1], "copy") == 0) {
+        const int extents = strcmp(argv[2], "--extents") == 0 ? 1 : 0;
+        if (argc < 5 + extents) {
+            std::cerr << "Usage: " << argv[0]
+                      << " copy [--extents] <disk_path> <file_name> "
+                         "<dest_path> [partition_index]"
+                      << std::endl;
+            return 1;
+        }
+        fs::path diskPath(argv[2 + extents]);
+        std::string fileName(argv[3 + extents]);
+        std::string destPath(argv[4 + extents]);
+        int partitionIndex = 0;
+        if (argc > 5 + extents) {
+            partitionIndex = std::stoi(argv[5 + extents]);
+        }
+        ok = copyFile(diskPath, fileName, destPath, partitionIndex,
+                      extents ? ionicfs::FileLayout::Extents
+                              : ionicfs::FileLayout::Chain);
+    } else if (strcmp(argv[1], "cp") == 0) {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0]
+                      << " cp <disk_path>[:partition_index]:<path> "
+                         "<disk_path>[:partition_index]:<dest_path>"
+                      << std::endl;
+            return 1;
+        }
+        ok = copyBetween(argv[2], argv[3]);
+    } else if (strcmp(argv[1], "write") == 0) {
+        if (argc < 7 || strcmp(argv[2], "--offset") != 0) {
+            std::cerr << "Usage: " << argv[0]
+                      << " write --offset <n> <disk_path> <file_name> "
+                         "<dest_path> [partition_index]"
+                      << std::endl;
+            return 1;
+        }
+        uint64_t offset = std::stoull(argv[3]);
+        fs::path diskPath(argv[4]);
+        std::string fileName(argv[5]);
+        std::string destPath(argv[6]);
+        int partitionIndex = 0;
+        if (argc > 7) {
+            partitionIndex = std::stoi(argv[7]);
+        }
+        ok = writeFile(diskPath, fileName, destPath, partitionIndex, offset);
+    } else if (strcmp(argv[1], "append") == 0) {
+        if (argc < 5) {
+            std::cerr << "Usage: " << argv[0]
+                      << " append <disk_path> <file_name> <dest_path> "
+                         "[partition_index]"
+                      << std::endl;
+            return 1;
+        }
         std::string path(argv[2]);
         fs::path diskPath(path);
         std::string fileName(argv[3]);
@@ -119,27 +267,52 @@ int main(int argc, char *argv[]) {
         if (argc > 5) {
             partitionIndex = std::stoi(argv[5]);
         }
-        copyFile(diskPath, fileName, destPath, partitionIndex);
+        ok = appendFile(diskPath, fileName, destPath, partitionIndex);
     } else if (strcmp(argv[1], "read") == 0) {
-        if (strcmp(argv[2], "-hex") == 0) {
-            std::string path(argv[3]);
-            fs::path diskPath(path);
-            std::string fileName(argv[4]);
-            int partitionIndex = 0;
-            if (argc > 5) {
-                partitionIndex = std::stoi(argv[5]);
+        bool hex = false;
+        uint64_t offset = 0;
+        std::optional<uint64_t> length;
+        std::vector<std::string> positional;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "-hex") == 0) {
+                hex = true;
+            } else if (strcmp(argv[i], "--offset") == 0 && i + 1 < argc) {
+                offset = std::stoull(argv[++i]);
+            } else if (strcmp(argv[i], "--length") == 0 && i + 1 < argc) {
+                length = std::stoull(argv[++i]);
+            } else {
+                positional.push_back(argv[i]);
             }
-            readFile(diskPath, fileName, partitionIndex, true);
-        } else {
-            std::string path(argv[2]);
-            fs::path diskPath(path);
-            std::string fileName(argv[3]);
-            int partitionIndex = 0;
-            if (argc > 4) {
-                partitionIndex = std::stoi(argv[4]);
-            }
-            readFile(diskPath, fileName, partitionIndex, false);
         }
+        if (positional.size() < 2) {
+            std::cerr << "Usage: " << argv[0]
+                      << " read [-hex] [--offset <n>] [--length <m>] "
+                         "<disk_path> <file_name> [partition_index]"
+                      << std::endl;
+            return 1;
+        }
+        fs::path diskPath(positional[0]);
+        int partitionIndex = 0;
+        if (positional.size() > 2) {
+            partitionIndex = std::stoi(positional[2]);
+        }
+        ok = readFile(diskPath, positional[1], partitionIndex, hex, offset,
+                      length);
+    } else if (strcmp(argv[1], "read-many") == 0) {
+        const int tar = strcmp(argv[2], "--tar") == 0 ? 1 : 0;
+        if (argc < 5 + tar) {
+            std::cerr << "Usage: " << argv[0]
+                      << " read-many [--tar] <disk_path> <path_list> "
+                         "<output> [partition_index]"
+                      << std::endl;
+            return 1;
+        }
+        int partitionIndex = 0;
+        if (argc > 5 + tar) {
+            partitionIndex = std::stoi(argv[5 + tar]);
+        }
+        ok = readManyFiles(argv[2 + tar], argv[3 + tar], argv[4 + tar], tar,
+                           partitionIndex);
     } else if (strcmp(argv[1], "rm") == 0) {
         std::string path(argv[2]);
         fs::path diskPath(path);
@@ -148,7 +321,7 @@ int main(int argc, char *argv[]) {
         if (argc > 4) {
             partitionIndex = std::stoi(argv[4]);
         }
-        removeFile(diskPath, fileName, partitionIndex);
+        ok = removeFile(diskPath, fileName, partitionIndex);
     } else if (strcmp(argv[1], "rm-dir") == 0) {
         std::string path(argv[2]);
         fs::path diskPath(path);
@@ -157,16 +330,127 @@ int main(int argc, char *argv[]) {
         if (argc > 4) {
             partitionIndex = std::stoi(argv[4]);
         }
-        removeDirectory(diskPath, dirName, partitionIndex);
+        ok = removeDirectory(diskPath, dirName, partitionIndex);
+    } else if (strcmp(argv[1], "mv") == 0) {
+        if (argc < 5) {
+            std::cerr << "Usage: " << argv[0]
+                      << " mv <disk_path> <source> <dest_path> "
+                         "[partition_index]"
+                      << std::endl;
+            return 1;
+        }
+        int partitionIndex = 0;
+        if (argc > 5) {
+            partitionIndex = std::stoi(argv[5]);
+        }
+        ok = moveEntry(argv[2], argv[3], argv[4], partitionIndex);
+    } else if (strcmp(argv[1], "sync") == 0) {
+        bool compareHashes = false;
+        std::vector<std::string> positional;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--hash") == 0) {
+                compareHashes = true;
+            } else {
+                positional.push_back(argv[i]);
+            }
+        }
+        if (positional.size() < 3) {
+            std::cerr << "Usage: " << argv[0]
+                      << " sync [--hash] <host_dir> <disk_path> <dest_path> "
+                         "[partition_index]"
+                      << std::endl;
+            return 1;
+        }
+        int partitionIndex = 0;
+        if (positional.size() > 3) {
+            partitionIndex = std::stoi(positional[3]);
+        }
+        ok = syncDirectory(positional[0], positional[1], positional[2],
+                           partitionIndex, compareHashes);
+    } else if (strcmp(argv[1], "verify") == 0) {
+        if (argc < 5) {
+            std::cerr << "Usage: " << argv[0]
+                      << " verify <disk_path> <image_dir> <host_dir> "
+                         "[partition_index]"
+                      << std::endl;
+            return 1;
+        }
+        fs::path diskPath(argv[2]);
+        std::string imagePath(argv[3]);
+        fs::path hostDirectory(argv[4]);
+        int partitionIndex = 0;
+        if (argc > 5) {
+            partitionIndex = std::stoi(argv[5]);
+        }
+        ok = verifyDirectory(diskPath, imagePath, hostDirectory,
+                             partitionIndex);
+    } else if (strcmp(argv[1], "commit") == 0) {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0]
+                      << " commit <disk_path> <overlay_path> [output_path]"
+                      << std::endl;
+            return 1;
+        }
+        std::optional<fs::path> outputPath;
+        if (argc > 4) {
+            outputPath = argv[4];
+        }
+        ok = commitOverlay(argv[2], argv[3], outputPath);
+    } else if (strcmp(argv[1], "pack") == 0 ||
+               strcmp(argv[1], "unpack") == 0) {
+        if (argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " " << argv[1]
+                      << (strcmp(argv[1], "pack") == 0
+                              ? " <disk_path> <archive_path>"
+                              : " <archive_path> <disk_path>")
+                      << std::endl;
+            return 1;
+        }
+        ok = strcmp(argv[1], "pack") == 0 ? packDisk(argv[2], argv[3])
+                                          : unpackDisk(argv[2], argv[3]);
+    } else if (strcmp(argv[1], "fsck") == 0) {
+        const bool repair = strcmp(argv[2], "--repair") == 0;
+        if (repair && argc < 4) {
+            std::cerr << "Usage: " << argv[0] << " fsck [--repair] <disk_path>"
+                      << std::endl;
+            return 1;
+        }
+        ok = checkDisk(argv[repair ? 3 : 2], repair);
+    } else if (strcmp(argv[1], "resize") == 0) {
+        const int grow = strcmp(argv[2], "--disk-size") == 0 ? 2 : 0;
+        if (argc < 5 + grow) {
+            std::cerr << "Usage: " << argv[0]
+                      << " resize [--disk-size <bytes>] <disk_path> "
+                         "<partition_index> <regions|max>"
+                      << std::endl;
+            return 1;
+        }
+        std::optional<uint64_t> diskSize;
+        if (grow) {
+            diskSize = std::stoull(argv[3]);
+        }
+        ok = resizePartition(argv[2 + grow], std::stoi(argv[3 + grow]),
+                             argv[4 + grow], diskSize);
+    } else if (strcmp(argv[1], "batch") == 0) {
+        std::optional<fs::path> scriptPath;
+        if (argc > 3) {
+            scriptPath = argv[3];
+        }
+        ok = runBatch(argv[2], scriptPath);
+    } else if (strcmp(argv[1], "client") == 0) {
+        std::string operation = argc > 3 ? argv[3] : "";
+        std::vector<std::string> arguments(argv + std::min(argc, 4),
+                                           argv + argc);
+        ok = clientCommand(argv[2], operation, arguments);
     } else if (strcmp(argv[1], "boot") == 0) {
         std::string path(argv[2]);
         fs::path diskPath(path);
         std::string bootPath(argv[3]);
-        boot(diskPath, bootPath);
+        ok = boot(diskPath, bootPath);
     } else {
         std::cerr << "Unknown command: " << argv[1] << std::endl;
         std::cerr << "Usage: " << argv[0] << " <disk_path>" << std::endl;
         return 1;
     }
-    return 0;
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,52 @@
+#include "commands.hpp"
+#include "utils.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+// "-" streams the archive through stdout or stdin so stages can pipe it.
+bool packDisk(const fs::path &diskPath, const fs::path &archivePath) {
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, false)) {
+        return false;
+    }
+    if (archivePath == "-") {
+        return report(ionicfs::pack(image, std::cout));
+    }
+
+    std::ofstream archive(archivePath, std::ios::binary | std::ios::trunc);
+    if (!archive) {
+        std::cerr << "Error: Unable to create archive at " << archivePath
+                  << std::endl;
+        return false;
+    }
+    if (!report(ionicfs::pack(image, archive))) {
+        return false;
+    }
+    archive.close();
+    std::error_code error;
+    std::cout << "Packed " << image.information().diskSize << " bytes into "
+              << fs::file_size(archivePath, error) << " bytes." << std::endl;
+    return true;
+}
+
+bool unpackDisk(const fs::path &archivePath, const fs::path &diskPath) {
+    if (archivePath == "-") {
+        return report(ionicfs::unpack(std::cin, diskPath));
+    }
+
+    std::ifstream archive(archivePath, std::ios::binary);
+    if (!archive) {
+        std::cerr << "Error: Unable to open archive at " << archivePath
+                  << std::endl;
+        return false;
+    }
+    if (!report(ionicfs::unpack(archive, diskPath))) {
+        return false;
+    }
+    std::cout << "Unpacked " << archivePath << " into " << diskPath << "."
+              << std::endl;
+    return true;
+}
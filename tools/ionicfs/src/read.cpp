@@ -1,108 +1,217 @@
 #include "commands.hpp"
 #include "utils.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <string>
-
 #include <vector>
 
 namespace fs = std::filesystem;
 
-void readFile(const fs::path &diskPath, const std::string &fileName,
-              int partitionIndex, bool hex) {
-    if (!fs::exists(diskPath)) {
-        std::cerr << "Error: Disk path does not exist." << std::endl;
-        return;
+bool readFile(const fs::path &diskPath, const std::string &fileName,
+              int partitionIndex, bool hex, uint64_t offset,
+              std::optional<uint64_t> length) {
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, false)) {
+        return false;
     }
 
-    if (fs::is_directory(diskPath)) {
-        std::cerr << "Error: Disk path is a directory." << std::endl;
-        return;
+    ionicfs::DirectoryEntry entry;
+    if (!report(image.stat(partitionIndex, fileName, entry))) {
+        return false;
     }
-
-    if (fs::is_empty(diskPath)) {
-        std::cerr << "Error: Disk path is empty." << std::endl;
-        return;
+    const bool ranged = offset != 0 || length.has_value();
+    std::vector<char> buffer;
+    ionicfs::Status status =
+        ranged ? image.readRange(partitionIndex, fileName, offset,
+                                 length.value_or(UINT64_MAX), buffer)
+               : image.read(partitionIndex, fileName, buffer);
+    if (!report(status)) {
+        return false;
     }
 
-    std::fstream diskFile(diskPath,
-                          std::ios::in | std::ios::out | std::ios::binary);
-    if (!diskFile) {
-        std::cerr << "Error: Unable to open disk file." << std::endl;
-        return;
+    if (buffer.empty() && !ranged) {
+        std::cerr << "Error: File is empty." << std::endl;
+        return false;
+    }
+    if (hex) {
+        for (const auto &byte : buffer) {
+            std::cout << std::hex << static_cast<int>(byte) << " ";
+        }
+        std::cout << std::dec << std::endl;
+    } else {
+        std::cout.write(buffer.data(), buffer.size());
+        std::cout << std::endl;
+    }
+    std::cout << "File read successfully." << std::endl;
+    if (ranged) {
+        std::cout << "Read " << buffer.size() << " bytes at offset " << offset
+                  << "." << std::endl;
+    } else {
+        std::cout << "File size: " << buffer.size() << " bytes." << std::endl;
     }
+    std::cout << "File region: " << std::hex << entry.region << std::dec
+              << std::endl;
+    return true;
+}
+
+namespace {
 
-    DriveInformation info = getDriveInformation(diskPath).value();
-    if (partitionIndex < 0 || partitionIndex >= 4) {
-        std::cerr << "Error: Invalid partition index." << std::endl;
-        return;
+// Writes one ustar member: a 512 byte header, then the data padded to a
+// multiple of 512 bytes. Names longer than 100 bytes are split at a slash
+// into the prefix field.
+bool writeTarMember(std::ostream &out, const std::string &name,
+                    uint64_t modified, const std::vector<char> &data) {
+    std::size_t split = 0;
+    if (name.size() > 100) {
+        split = name.rfind('/', 155);
+        if (split == std::string::npos || name.size() - split - 1 > 100) {
+            return false;
+        }
+    }
+    if (data.size() >= (uint64_t{1} << 33)) {
+        return false;
     }
-    Partition partition = info.partitions[partitionIndex];
-    if (!partition.usable) {
-        std::cerr << "Error: Partition is not usable." << std::endl;
-        return;
+    char header[512] = {0};
+    const std::string prefix = split == 0 ? "" : name.substr(0, split);
+    const std::string leaf = split == 0 ? name : name.substr(split + 1);
+    std::memcpy(header, leaf.data(), leaf.size());
+    std::snprintf(header + 100, 8, "%07o", 0644);
+    std::snprintf(header + 108, 8, "%07o", 0);
+    std::snprintf(header + 116, 8, "%07o", 0);
+    std::snprintf(header + 124, 12, "%011llo",
+                  static_cast<unsigned long long>(data.size()));
+    std::snprintf(header + 136, 12, "%011llo",
+                  static_cast<unsigned long long>(modified));
+    header[156] = '0';
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+    std::memcpy(header + 345, prefix.data(), prefix.size());
+    // The checksum is taken with its own field filled with spaces.
+    std::memset(header + 148, ' ', 8);
+    unsigned checksum = 0;
+    for (unsigned char byte : header) {
+        checksum += byte;
     }
+    std::snprintf(header + 148, 8, "%06o", checksum);
+    header[155] = ' ';
 
-    std::string filePath = fileName;
-    std::string dirPath;
-    std::string bareFileName;
+    out.write(header, sizeof(header));
+    out.write(data.data(), data.size());
+    const std::size_t padding = (512 - data.size() % 512) % 512;
+    const char zeroes[512] = {0};
+    out.write(zeroes, padding);
+    return static_cast<bool>(out);
+}
 
-    size_t lastSlashPos = filePath.find_last_of('/');
-    if (lastSlashPos != std::string::npos) {
-        dirPath = filePath.substr(0, lastSlashPos);
-        bareFileName = filePath.substr(lastSlashPos + 1);
-    } else {
-        dirPath = "."; // Current directory
-        bareFileName = filePath;
+// Image paths become relative host paths. Components that would leave the
+// output directory are refused.
+bool hostRelativePath(const std::string &path, fs::path &relative) {
+    relative.clear();
+    std::size_t start = 0;
+    while (start <= path.size()) {
+        std::size_t slash = path.find('/', start);
+        if (slash == std::string::npos) {
+            slash = path.size();
+        }
+        const std::string component = path.substr(start, slash - start);
+        if (component == "..") {
+            return false;
+        }
+        if (!component.empty() && component != ".") {
+            relative /= component;
+        }
+        start = slash + 1;
     }
+    return !relative.empty();
+}
 
-    uint32_t directoryRegion =
-        traverseDirectory(diskPath, dirPath, partitionIndex);
+} // namespace
 
-    uint32_t region =
-        findFileInDirectory(diskPath, bareFileName, directoryRegion);
-    if (region == 0) {
-        std::cerr << "Error: File not found." << std::endl;
-        return;
+bool readManyFiles(const fs::path &diskPath, const fs::path &listPath,
+                   const fs::path &outputPath, bool tar, int partitionIndex) {
+    std::ifstream listFile;
+    if (listPath != "-") {
+        listFile.open(listPath);
+        if (!listFile) {
+            std::cerr << "Error: Unable to open path list at " << listPath
+                      << std::endl;
+            return false;
+        }
     }
-    diskFile.seekg(region * 512);
-    std::vector<char> buffer;
-    while (true) {
-        char byte;
-        diskFile.read(&byte, sizeof(byte));
-        if (byte == FILE_REGION) {
-            char fileData[507];
-            diskFile.read(fileData, sizeof(fileData));
-            buffer.insert(buffer.end(), fileData, fileData + sizeof(fileData));
-            uint32_t nextRegion;
-            diskFile.read(reinterpret_cast<char *>(&nextRegion),
-                          sizeof(nextRegion));
-            if (nextRegion == 0) {
-                break;
-            }
-            region = nextRegion;
-            diskFile.seekg(region * 512);
-        } else {
-            break;
+    std::istream &list = listPath == "-" ? std::cin : listFile;
+    std::vector<std::string> paths;
+    for (std::string line; std::getline(list, line);) {
+        if (!line.empty()) {
+            paths.push_back(line);
         }
     }
 
-    if (buffer.empty()) {
-        std::cerr << "Error: File is empty." << std::endl;
-        return;
-    }
-    if (hex) {
-        for (const auto &byte : buffer) {
-            std::cout << std::hex << static_cast<int>(byte) << " ";
+    // "-" streams the tar archive through stdout, so messages go to stderr.
+    const bool toStdout = tar && outputPath == "-";
+    std::ostream &messages = toStdout ? std::cerr : std::cout;
+    std::ofstream archiveFile;
+    if (tar && !toStdout) {
+        archiveFile.open(outputPath, std::ios::binary | std::ios::trunc);
+        if (!archiveFile) {
+            std::cerr << "Error: Unable to create archive at " << outputPath
+                      << std::endl;
+            return false;
         }
-        std::cout << std::dec << std::endl;
-    } else {
-        std::cout.write(buffer.data(), buffer.size());
-        std::cout << std::endl;
     }
-    diskFile.close();
-    std::cout << "File read successfully." << std::endl;
-    std::cout << "File size: " << buffer.size() << " bytes." << std::endl;
-    std::cout << "File region: " << std::hex << region << std::dec << std::endl;
-}
\ No newline at end of file
+    std::ostream &archive = toStdout ? std::cout : archiveFile;
+
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, false)) {
+        return false;
+    }
+    int failed = 0;
+    uint64_t bytes = 0;
+    ionicfs::Status status = image.readMany(
+        partitionIndex, paths,
+        [&](std::size_t index, ionicfs::Status status,
+            const ionicfs::DirectoryEntry &entry, std::vector<char> &data) {
+            const std::string &path = paths[index];
+            fs::path relative;
+            bool ok = status == ionicfs::Status::Ok;
+            if (ok && !hostRelativePath(path, relative)) {
+                status = ionicfs::Status::InvalidName;
+                ok = false;
+            }
+            if (ok && tar) {
+                ok = writeTarMember(archive, relative.generic_string(),
+                                    entry.lastModified, data);
+            } else if (ok) {
+                const fs::path target = outputPath / relative;
+                std::error_code error;
+                fs::create_directories(target.parent_path(), error);
+                std::ofstream file(target, std::ios::binary | std::ios::trunc);
+                file.write(data.data(), data.size());
+                ok = static_cast<bool>(file);
+            }
+            if (!ok) {
+                std::cerr << "Error: " << path << ": "
+                          << (status == ionicfs::Status::Ok
+                                  ? "Unable to write output"
+                                  : ionicfs::statusMessage(status))
+                          << "." << std::endl;
+                failed++;
+                return;
+            }
+            bytes += data.size();
+        });
+    if (!report(status)) {
+        return false;
+    }
+    if (tar) {
+        const char end[1024] = {0};
+        archive.write(end, sizeof(end));
+        archive.flush();
+    }
+    messages << "Read " << paths.size() - failed << " files (" << bytes
+             << " bytes), " << failed << " failed." << std::endl;
+    return failed == 0 && (!tar || archive);
+}
@@ -0,0 +1,55 @@
+#include "commands.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+
+namespace fs = std::filesystem;
+
+bool resizePartition(const fs::path &diskPath, int partitionIndex,
+                     const std::string &size,
+                     std::optional<uint64_t> diskSize) {
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, true)) {
+        return false;
+    }
+    if (diskSize && !report(image.growDisk(*diskSize))) {
+        return false;
+    }
+    const ionicfs::DriveInformation &drive = image.information();
+    if (partitionIndex < 0 || partitionIndex >= 4) {
+        return report(ionicfs::Status::InvalidPartition);
+    }
+    const ionicfs::Partition &partition = drive.partitions[partitionIndex];
+    if (!partition.usable) {
+        return report(ionicfs::Status::PartitionUnusable);
+    }
+    const uint32_t oldSize = partition.partitionSize;
+
+    uint64_t regions = 0;
+    if (size == "max") {
+        // Up to the next partition, or the end of the disk.
+        uint64_t end = drive.totalRegions;
+        for (const ionicfs::Partition &other : drive.partitions) {
+            if (other.usable &&
+                other.partitionRegion > partition.partitionRegion) {
+                end = std::min<uint64_t>(end, other.partitionRegion);
+            }
+        }
+        regions = end - partition.partitionRegion;
+    } else {
+        regions = std::stoull(size);
+    }
+    if (regions > UINT32_MAX) {
+        return report(ionicfs::Status::InvalidArgument);
+    }
+    if (!report(image.resize(partitionIndex,
+                             static_cast<uint32_t>(regions)))) {
+        return false;
+    }
+    std::cout << "Partition " << trim(partition.name) << " resized from "
+              << oldSize << " to " << regions << " regions." << std::endl;
+    return true;
+}
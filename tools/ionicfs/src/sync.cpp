@@ -0,0 +1,234 @@
+#include "commands.hpp"
+#include "hash.hpp"
+#include "utils.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct SyncContext {
+    ionicfs::Image &image;
+    int partitionIndex;
+    bool compareHashes;
+    // Whether entries record file sizes (format 005 on).
+    bool sizedEntries;
+    int added = 0;
+    int updated = 0;
+    int removed = 0;
+    int unchanged = 0;
+};
+
+uint64_t modificationTime(const fs::path &path) {
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(info.st_mtime);
+}
+
+bool readHostFile(const fs::path &path, std::vector<char> &buffer) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Unable to open source file at " << path
+                  << std::endl;
+        return false;
+    }
+    buffer.assign(std::istreambuf_iterator<char>(file), {});
+    return true;
+}
+
+std::string joinPath(const std::string &directory, const std::string &name) {
+    if (directory.empty() || directory == "/") {
+        return name;
+    }
+    return directory + "/" + name;
+}
+
+bool syncFile(SyncContext &context, const fs::path &hostPath,
+              const std::string &imagePath,
+              const ionicfs::DirectoryEntry *existing) {
+    const uint64_t modified = modificationTime(hostPath);
+    // Timestamps only have one second resolution, so on disks that record
+    // it the size must match as well.
+    std::error_code error;
+    const bool sameSize = !context.sizedEntries ||
+                          (existing != nullptr &&
+                           existing->size == fs::file_size(hostPath, error) &&
+                           !error);
+    if (existing != nullptr && !context.compareHashes &&
+        existing->lastModified == modified && sameSize) {
+        context.unchanged++;
+        return true;
+    }
+
+    std::vector<char> contents;
+    if (!readHostFile(hostPath, contents)) {
+        return false;
+    }
+    if (existing != nullptr) {
+        std::vector<char> stored;
+        if (!report(context.image.read(context.partitionIndex, imagePath,
+                                       stored))) {
+            return false;
+        }
+        const uint64_t hostHash =
+            ionicfs::contentHash(contents.data(), contents.size());
+        if (sameContent(context.image.information().regionSize,
+                        contents.size(), hostHash, stored)) {
+            context.unchanged++;
+            if (existing->lastModified == modified) {
+                return true;
+            }
+            return report(context.image.touch(context.partitionIndex,
+                                              imagePath, modified));
+        }
+    }
+
+    // Replacing the file is one transaction: a failure leaves the old
+    // contents in place, and the disk is synced once.
+    ionicfs::Transaction transaction(context.image);
+    if (existing != nullptr &&
+        !report(context.image.remove(context.partitionIndex, imagePath))) {
+        return false;
+    }
+    if (!report(context.image.write(context.partitionIndex, imagePath,
+                                    contents.data(), contents.size())) ||
+        !report(context.image.touch(context.partitionIndex, imagePath,
+                                    modified)) ||
+        !report(transaction.commit())) {
+        return false;
+    }
+    std::cout << (existing != nullptr ? "~ " : "+ ") << imagePath
+              << std::endl;
+    (existing != nullptr ? context.updated : context.added)++;
+    return true;
+}
+
+bool syncTree(SyncContext &context, const fs::path &hostDirectory,
+              const std::string &imageDirectory) {
+    ionicfs::Directory directory;
+    if (!report(context.image.list(context.partitionIndex, imageDirectory,
+                                   directory))) {
+        return false;
+    }
+    std::unordered_map<std::string_view, const ionicfs::DirectoryEntry *>
+        stale;
+    for (const auto &entry : directory.entries) {
+        if (entry.name != ".") {
+            stale.emplace(entry.name, &entry);
+        }
+    }
+
+    std::error_code error;
+    for (const auto &hostEntry : fs::directory_iterator(hostDirectory, error)) {
+        const std::string name = hostEntry.path().filename().string();
+        const std::string imagePath = joinPath(imageDirectory, name);
+        const bool isDirectory = hostEntry.is_directory();
+        if (!isDirectory && !hostEntry.is_regular_file()) {
+            continue;
+        }
+
+        const ionicfs::DirectoryEntry *existing = nullptr;
+        auto found = stale.find(name);
+        if (found != stale.end()) {
+            existing = found->second;
+            stale.erase(found);
+        }
+        if (existing != nullptr && existing->isDirectory != isDirectory) {
+            ionicfs::Status status =
+                existing->isDirectory
+                    ? context.image.removeDirectory(context.partitionIndex,
+                                                    imagePath)
+                    : context.image.remove(context.partitionIndex, imagePath);
+            if (!report(status)) {
+                return false;
+            }
+            std::cout << "- " << imagePath << std::endl;
+            context.removed++;
+            existing = nullptr;
+        }
+
+        if (isDirectory) {
+            if (existing == nullptr) {
+                if (!report(context.image.mkdir(context.partitionIndex,
+                                                imagePath))) {
+                    return false;
+                }
+                std::cout << "+ " << imagePath << "/" << std::endl;
+                context.added++;
+            }
+            if (!syncTree(context, hostEntry.path(), imagePath)) {
+                return false;
+            }
+        } else if (!syncFile(context, hostEntry.path(), imagePath, existing)) {
+            return false;
+        }
+    }
+    if (error) {
+        std::cerr << "Error: Unable to read directory " << hostDirectory
+                  << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    for (const auto &[name, entry] : stale) {
+        const std::string imagePath =
+            joinPath(imageDirectory, std::string(name));
+        ionicfs::Status status =
+            entry->isDirectory
+                ? context.image.removeDirectory(context.partitionIndex,
+                                                imagePath)
+                : context.image.remove(context.partitionIndex, imagePath);
+        if (!report(status)) {
+            return false;
+        }
+        std::cout << "- " << imagePath << (entry->isDirectory ? "/" : "")
+                  << std::endl;
+        context.removed++;
+    }
+    return true;
+}
+
+} // namespace
+
+bool syncDirectory(const fs::path &hostDirectory, const fs::path &diskPath,
+                   const std::string &imagePath, int partitionIndex,
+                   bool compareHashes) {
+    if (!fs::is_directory(hostDirectory)) {
+        std::cerr << "Error: " << hostDirectory << " is not a directory."
+                  << std::endl;
+        return false;
+    }
+    ionicfs::Image image;
+    if (!openImage(image, diskPath, true)) {
+        return false;
+    }
+
+    ionicfs::DirectoryEntry target;
+    ionicfs::Status status = image.stat(partitionIndex, imagePath, target);
+    if (status == ionicfs::Status::NotFound) {
+        status = image.mkdir(partitionIndex, imagePath);
+    } else if (status == ionicfs::Status::Ok && !target.isDirectory) {
+        status = ionicfs::Status::NotADirectory;
+    }
+    if (!report(status)) {
+        return false;
+    }
+
+    SyncContext context{
+        image, partitionIndex, compareHashes,
+        std::strcmp(image.information().version + 5, "005") >= 0};
+    bool ok = syncTree(context, hostDirectory, imagePath);
+    std::cout << "Sync " << (ok ? "complete" : "stopped") << ": "
+              << context.added << " added, " << context.updated
+              << " updated, " << context.removed << " removed, "
+              << context.unchanged << " unchanged." << std::endl;
+    return ok;
+}
@@ -1,4 +1,7 @@
 
+#include "hash.hpp"
+#include "layout.hpp"
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -38,8 +41,45 @@ std::string unixTimeToString(uint64_t unixTime) {
     return std::string(buffer);
 }
 
-uint64_t getTime() {
-    return std::chrono::duration_cast<std::chrono::seconds>(
-               std::chrono::system_clock::now().time_since_epoch())
-        .count();
-}
\ No newline at end of file
+bool report(ionicfs::Status status) {
+    if (status == ionicfs::Status::Ok) {
+        return true;
+    }
+    std::cerr << "Error: " << ionicfs::statusMessage(status) << "."
+              << std::endl;
+    return false;
+}
+
+static ionicfs::OpenOptions options;
+
+void useOverlay(const std::filesystem::path &path) {
+    options.overlayPath = path;
+}
+
+void useDirectIo() { options.direct = true; }
+
+void useLockTimeout(std::chrono::milliseconds timeout) {
+    options.lockTimeout = timeout;
+}
+
+const ionicfs::OpenOptions &openOptions() { return options; }
+
+bool openImage(ionicfs::Image &image, const std::filesystem::path &diskPath,
+               bool writable) {
+    return report(image.open(diskPath, writable, options));
+}
+bool sameContent(uint32_t regionSize, uint64_t hostSize, uint64_t hostHash,
+                 const std::vector<char> &stored) {
+    if (stored.size() == hostSize) {
+        return ionicfs::contentHash(stored.data(), hostSize) == hostHash;
+    }
+    const ionicfs::Geometry geometry = ionicfs::geometryFor(regionSize);
+    const uint64_t padded =
+        uint64_t{geometry.regionsFor(hostSize)} * geometry.payload;
+    if (stored.size() != padded ||
+        ionicfs::contentHash(stored.data(), hostSize) != hostHash) {
+        return false;
+    }
+    return std::all_of(stored.begin() + hostSize, stored.end(),
+                       [](char byte) { return byte == 0; });
+}
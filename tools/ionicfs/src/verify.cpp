@@ -0,0 +1,223 @@
+#include "commands.hpp"
+#include "hash.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Relative path of every file and directory of a tree, mapped to whether
+// it is a directory.
+using Tree = std::map<std::string, bool>;
+
+enum class Outcome { Match, Mismatch, HostUnreadable, ImageUnreadable };
+
+struct Comparison {
+    std::string path;
+    fs::path hostPath;
+    uint64_t hostSize = 0;
+    Outcome outcome = Outcome::Match;
+    ionicfs::Status status = ionicfs::Status::Ok;
+};
+
+std::string joinPath(const std::string &directory, const std::string &name) {
+    if (directory.empty() || directory == "/") {
+        return name;
+    }
+    return directory + "/" + name;
+}
+
+bool collectImageTree(ionicfs::Image &image, int partitionIndex,
+                      const std::string &imageDirectory,
+                      const std::string &relative, Tree &tree) {
+    ionicfs::Directory directory;
+    if (!report(image.list(partitionIndex, imageDirectory, directory))) {
+        return false;
+    }
+    for (const auto &entry : directory.entries) {
+        if (entry.name == ".") {
+            continue;
+        }
+        const std::string name(entry.name);
+        const std::string path = joinPath(relative, name);
+        tree[path] = entry.isDirectory;
+        if (entry.isDirectory &&
+            !collectImageTree(image, partitionIndex,
+                              joinPath(imageDirectory, name), path, tree)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool collectHostTree(const fs::path &hostDirectory, Tree &tree) {
+    std::error_code error;
+    fs::recursive_directory_iterator it(hostDirectory, error), end;
+    for (; !error && it != end; it.increment(error)) {
+        const bool isDirectory = it->is_directory();
+        if (isDirectory || it->is_regular_file()) {
+            tree[fs::relative(it->path(), hostDirectory).generic_string()] =
+                isDirectory;
+        }
+    }
+    if (error) {
+        std::cerr << "Error: Unable to read directory " << hostDirectory
+                  << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Streams the host file through the hash so only the image copy is held in
+// memory.
+bool hashHostFile(const fs::path &path, uint64_t &size, uint64_t &digest) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    ionicfs::ContentHash hash;
+    std::vector<char> chunk(64 * 1024);
+    size = 0;
+    while (file) {
+        file.read(chunk.data(), chunk.size());
+        hash.update(chunk.data(), file.gcount());
+        size += file.gcount();
+    }
+    if (file.bad()) {
+        return false;
+    }
+    digest = hash.digest();
+    return true;
+}
+
+void compareFile(ionicfs::Image &image, int partitionIndex,
+                 const std::string &imageDirectory, Comparison &comparison) {
+    uint64_t hostSize = 0;
+    uint64_t hostHash = 0;
+    if (!hashHostFile(comparison.hostPath, hostSize, hostHash)) {
+        comparison.outcome = Outcome::HostUnreadable;
+        return;
+    }
+    std::vector<char> stored;
+    comparison.status = image.read(
+        partitionIndex, joinPath(imageDirectory, comparison.path), stored);
+    if (comparison.status != ionicfs::Status::Ok) {
+        comparison.outcome = Outcome::ImageUnreadable;
+        return;
+    }
+    comparison.outcome = sameContent(image.information().regionSize,
+                                     hostSize, hostHash, stored)
+                             ? Outcome::Match
+                             : Outcome::Mismatch;
+}
+
+} // namespace
+
+bool verifyDirectory(const fs::path &diskPath, const std::string &imagePath,
+                     const fs::path &hostDirectory, int partitionIndex) {
+    if (!fs::is_directory(hostDirectory)) {
+        std::cerr << "Error: " << hostDirectory << " is not a directory."
+                  << std::endl;
+        return false;
+    }
+    ionicfs::ThreadPool pool;
+    // One handle per worker: images cache chains and are not thread-safe.
+    std::vector<std::unique_ptr<ionicfs::Image>> images;
+    for (std::size_t i = 0; i < pool.size(); i++) {
+        images.push_back(std::make_unique<ionicfs::Image>());
+        if (!openImage(*images.back(), diskPath, false)) {
+            return false;
+        }
+    }
+
+    Tree imageTree;
+    Tree hostTree;
+    if (!collectImageTree(*images.front(), partitionIndex, imagePath, "",
+                          imageTree) ||
+        !collectHostTree(hostDirectory, hostTree)) {
+        return false;
+    }
+
+    std::vector<std::string> missing;
+    std::vector<std::string> extra;
+    std::vector<Comparison> comparisons;
+    for (const auto &[path, isDirectory] : hostTree) {
+        auto found = imageTree.find(path);
+        if (found == imageTree.end() || found->second != isDirectory) {
+            missing.push_back(path);
+        } else if (!isDirectory) {
+            Comparison &comparison = comparisons.emplace_back();
+            comparison.path = path;
+            comparison.hostPath = hostDirectory / path;
+            std::error_code error;
+            comparison.hostSize = fs::file_size(comparison.hostPath, error);
+        }
+    }
+    for (const auto &[path, isDirectory] : imageTree) {
+        auto found = hostTree.find(path);
+        if (found == hostTree.end() || found->second != isDirectory) {
+            extra.push_back(path);
+        }
+    }
+
+    // Largest files first so a big file does not start last and keep one
+    // worker busy after the others have run out of work.
+    std::vector<Comparison *> order;
+    for (auto &comparison : comparisons) {
+        order.push_back(&comparison);
+    }
+    std::sort(order.begin(), order.end(), [](const auto *a, const auto *b) {
+        return a->hostSize > b->hostSize;
+    });
+    for (Comparison *comparison : order) {
+        pool.submit([&, comparison](std::size_t worker) {
+            compareFile(*images[worker], partitionIndex, imagePath,
+                        *comparison);
+        });
+    }
+    pool.wait();
+
+    int matched = 0;
+    int mismatched = 0;
+    for (const auto &comparison : comparisons) {
+        switch (comparison.outcome) {
+        case Outcome::Match:
+            matched++;
+            continue;
+        case Outcome::Mismatch:
+            std::cout << RED << "Mismatch: " << RESET << comparison.path
+                      << std::endl;
+            break;
+        case Outcome::HostUnreadable:
+            std::cout << RED << "Mismatch: " << RESET << comparison.path
+                      << " (unable to read host file)" << std::endl;
+            break;
+        case Outcome::ImageUnreadable:
+            std::cout << RED << "Mismatch: " << RESET << comparison.path
+                      << " (" << ionicfs::statusMessage(comparison.status)
+                      << ")" << std::endl;
+            break;
+        }
+        mismatched++;
+    }
+    for (const auto &path : missing) {
+        std::cout << YELLOW << "Missing: " << RESET << path << std::endl;
+    }
+    for (const auto &path : extra) {
+        std::cout << YELLOW << "Extra: " << RESET << path << std::endl;
+    }
+
+    std::cout << "Verify complete: " << matched << " matched, " << mismatched
+              << " mismatched, " << missing.size() << " missing, "
+              << extra.size() << " extra." << std::endl;
+    return mismatched == 0 && missing.empty() && extra.empty();
+}
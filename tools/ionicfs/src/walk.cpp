@@ -0,0 +1,194 @@
+#include "commands.hpp"
+#include "thread_pool.hpp"
+#include "utils.hpp"
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <fnmatch.h>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string joinPath(const std::string &directory, std::string_view name) {
+    std::string path = directory;
+    if (path.empty() || path.back() != '/') {
+        path += '/';
+    }
+    return path.append(name);
+}
+
+// A directory still being walked. Its totals are final, and reported, once
+// the directory and every subdirectory have been listed.
+struct Node {
+    std::string path;
+    Node *parent = nullptr;
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> files{0};
+    // The listing of the directory itself, plus one per subdirectory not
+    // finished yet.
+    std::atomic<std::size_t> remaining{1};
+};
+
+// Walks the tree under a directory with one task per directory, each
+// listing it on the image of its worker. Entries and finished directories
+// reach the visitors as they are found, from any worker.
+class TreeWalk {
+  public:
+    using EntryVisitor = std::function<void(
+        ionicfs::Image &, Node &, const ionicfs::DirectoryEntry &)>;
+    using DirectoryVisitor = std::function<void(const Node &)>;
+
+    TreeWalk(int partitionIndex, EntryVisitor onEntry,
+             DirectoryVisitor onDirectory = nullptr)
+        : partitionIndex(partitionIndex), onEntry(std::move(onEntry)),
+          onDirectory(std::move(onDirectory)) {}
+
+    bool run(const fs::path &diskPath, const std::string &path) {
+        // One handle per worker: images cache chains and are not
+        // thread-safe.
+        for (std::size_t i = 0; i < pool.size(); i++) {
+            images.push_back(std::make_unique<ionicfs::Image>());
+            if (!openImage(*images.back(), diskPath, false)) {
+                return false;
+            }
+        }
+        ionicfs::DirectoryEntry root;
+        if (!report(images.front()->stat(partitionIndex, path, root))) {
+            return false;
+        }
+        if (!root.isDirectory) {
+            return report(ionicfs::Status::NotADirectory);
+        }
+        Node *node = newNode(path.empty() ? "/" : path, nullptr);
+        pool.submit([this, node](std::size_t worker) { walk(worker, node); });
+        pool.wait();
+        return report(status);
+    }
+
+  private:
+    Node *newNode(std::string path, Node *parent) {
+        std::lock_guard lock(mutex);
+        Node &node = nodes.emplace_back();
+        node.path = std::move(path);
+        node.parent = parent;
+        return &node;
+    }
+
+    void walk(std::size_t worker, Node *node) {
+        ionicfs::Image &image = *images[worker];
+        std::vector<std::string> subdirectories;
+        ionicfs::Status result = image.visit(
+            partitionIndex, node->path,
+            [&](const ionicfs::DirectoryEntry &entry) {
+                if (entry.name == ".") {
+                    return false;
+                }
+                if (entry.isDirectory) {
+                    subdirectories.emplace_back(entry.name);
+                }
+                onEntry(image, *node, entry);
+                return false;
+            });
+        if (result != ionicfs::Status::Ok) {
+            std::lock_guard lock(mutex);
+            if (status == ionicfs::Status::Ok) {
+                status = result;
+            }
+        }
+        node->remaining += subdirectories.size();
+        for (const std::string &name : subdirectories) {
+            Node *child = newNode(joinPath(node->path, name), node);
+            pool.submit(
+                [this, child](std::size_t worker) { walk(worker, child); });
+        }
+        finish(node);
+    }
+
+    // Directories finish bottom up, adding their totals to their parent.
+    void finish(Node *node) {
+        while (node != nullptr && --node->remaining == 0) {
+            if (onDirectory) {
+                onDirectory(*node);
+            }
+            if (node->parent != nullptr) {
+                node->parent->bytes += node->bytes;
+                node->parent->files += node->files;
+            }
+            node = node->parent;
+        }
+    }
+
+    const int partitionIndex;
+    EntryVisitor onEntry;
+    DirectoryVisitor onDirectory;
+    std::vector<std::unique_ptr<ionicfs::Image>> images;
+    std::mutex mutex;
+    // A deque keeps nodes in place as it grows.
+    std::deque<Node> nodes;
+    ionicfs::Status status = ionicfs::Status::Ok;
+    // Last member: its destructor joins the workers before the rest goes.
+    ionicfs::ThreadPool pool;
+};
+
+} // namespace
+
+bool diskUsage(const fs::path &diskPath, const std::string &path,
+               int partitionIndex) {
+    std::mutex outputMutex;
+    TreeWalk walk(
+        partitionIndex,
+        [&](ionicfs::Image &image, Node &directory,
+            const ionicfs::DirectoryEntry &entry) {
+            if (entry.isDirectory) {
+                return;
+            }
+            uint64_t size = entry.size;
+            if (size == 0) {
+                // Entries of disks before format 005 record no size.
+                ionicfs::DirectoryEntry measured;
+                if (image.stat(partitionIndex,
+                               joinPath(directory.path, entry.name),
+                               measured) == ionicfs::Status::Ok) {
+                    size = measured.size;
+                }
+            }
+            directory.bytes += size;
+            directory.files++;
+        },
+        [&](const Node &directory) {
+            std::lock_guard lock(outputMutex);
+            std::cout << directory.bytes << "\t" << directory.path << "\n";
+            if (directory.parent == nullptr) {
+                std::cout << directory.files << " files, " << directory.bytes
+                          << " bytes." << std::endl;
+            }
+        });
+    return walk.run(diskPath, path);
+}
+
+bool findEntries(const fs::path &diskPath, const std::string &path,
+                 const std::string &pattern, int partitionIndex) {
+    std::mutex outputMutex;
+    std::atomic<uint64_t> matches{0};
+    TreeWalk walk(partitionIndex, [&](ionicfs::Image &, Node &directory,
+                                      const ionicfs::DirectoryEntry &entry) {
+        const std::string name(entry.name);
+        if (fnmatch(pattern.c_str(), name.c_str(), 0) != 0) {
+            return;
+        }
+        matches++;
+        std::lock_guard lock(outputMutex);
+        std::cout << joinPath(directory.path, name)
+                  << (entry.isDirectory ? "/" : "") << "\n";
+    });
+    const bool ok = walk.run(diskPath, path);
+    std::cout << matches << " matches." << std::endl;
+    return ok;
+}
@@ -0,0 +1,89 @@
+#include "thread_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
+
+// Wakes the workers over and over with a few tasks at a time, which the
+// others often take first, then submits bursts of one task per worker, each
+// holding its worker until the whole burst is running. A burst only
+// completes if every worker is still in the pool, so a worker that left
+// after waking to an empty queue shows up as a timeout.
+int main() {
+    constexpr std::size_t workers = 4;
+    constexpr int bursts = 200;
+    ionicfs::ThreadPool pool(workers);
+
+    std::atomic<std::size_t> churned = 0;
+    std::size_t submitted = 0;
+    for (int round = 0; round < 20000; round++) {
+        for (int i = 0; i <= round % 3; i++) {
+            pool.submit([&](std::size_t) { churned++; });
+            submitted++;
+        }
+        if (round % 50 == 0) {
+            pool.wait();
+        }
+    }
+    pool.wait();
+    if (churned != submitted) {
+        std::cerr << "Ran " << churned << " of " << submitted << " tasks."
+                  << std::endl;
+        return 1;
+    }
+
+    std::atomic<std::size_t> arrived = 0;
+    std::atomic<bool> timedOut = false;
+    std::mutex seenMutex;
+
+    for (int burst = 0; burst < bursts; burst++) {
+        const std::size_t target = (burst + 1) * workers;
+        std::set<std::size_t> seen;
+        for (std::size_t i = 0; i < workers; i++) {
+            pool.submit([&, target](std::size_t worker) {
+                {
+                    std::lock_guard lock(seenMutex);
+                    seen.insert(worker);
+                }
+                arrived++;
+                const auto deadline =
+                    std::chrono::steady_clock::now() + std::chrono::seconds(5);
+                while (arrived < target) {
+                    if (std::chrono::steady_clock::now() > deadline) {
+                        timedOut = true;
+                        return;
+                    }
+                    std::this_thread::yield();
+                }
+            });
+        }
+        pool.wait();
+        if (timedOut || seen.size() != workers) {
+            std::cerr << "Burst " << burst << " ran on " << seen.size()
+                      << " of " << workers << " workers." << std::endl;
+            return 1;
+        }
+        if (burst % 4 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Tasks submitted by tasks still reach every worker.
+    std::atomic<std::size_t> done = 0;
+    for (std::size_t i = 0; i < workers; i++) {
+        pool.submit([&](std::size_t) {
+            for (int j = 0; j < 1000; j++) {
+                pool.submit([&](std::size_t) { done++; });
+            }
+        });
+    }
+    pool.wait();
+    if (done != workers * 1000) {
+        std::cerr << "Ran " << done << " of " << workers * 1000
+                  << " nested tasks." << std::endl;
+        return 1;
+    }
+    return 0;
+}